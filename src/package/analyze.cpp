@@ -0,0 +1,210 @@
+// Batch analysis: searches many positions in parallel and prints best move, score and PV for each.
+// Input is either a file of concatenated `state` blocks (as written by main.cpp) or a selfplay game
+// record, in which case every position of every game is analysed. With -k the best k moves of each
+// position are ranked in one Multi-PV search, with their scores and PVs.
+// -m is a soft limit: a position is deepened while the next iteration is expected to finish within
+// the time, but an iteration that has started is never interrupted (a slow one can overrun).
+//
+//   ./analyze <positions> [-d depth | -m movetime_ms] [-t threads] [-k moves]
+
+#define ALPHAOTHELLO_NO_MAIN
+#include "player_new.cpp"
+#include "gamerecord.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+struct AnalyzeConfig {
+    std::string input;
+    int depth = 0;    // 0: the depth of the parameter file
+    int movetime = 0; // ms, iterative deepening instead of a fixed depth when set
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    int multipv = 1;
+};
+
+struct Analysis {
+    int depth = 0;
+    int score = 0;
+    std::vector<Point> pv;
+    std::vector<RootMove> lines; // Multi-PV only
+};
+
+// Positions from `state` blocks: player, SIZE rows, number of spots, spots.
+bool read_states(const std::string& filename, std::vector<OthelloBoard>& positions) {
+    std::ifstream fin(filename);
+    if (!fin) return false;
+    int cur_player;
+    while (fin >> cur_player) {
+        OthelloBoard board;
+        for (int i = 0; i < SIZE; i++)
+            for (int j = 0; j < SIZE; j++)
+                fin >> board.board[i][j];
+        int n_valid_spots, x, y;
+        fin >> n_valid_spots;
+        for (int i = 0; i < n_valid_spots; i++)
+            fin >> x >> y;
+        GameClock clock;
+        read_clock(fin, clock);
+        if (!fin) return false;
+        board.cur_player = cur_player;
+        board.sync();
+        board.next_valid_spots = board.get_valid_spots();
+        if (!board.next_valid_spots.empty())
+            positions.push_back(board);
+    }
+    return true;
+}
+
+bool read_games(const std::string& filename, std::vector<OthelloBoard>& positions) {
+    GameReader reader;
+    if (!reader.open(filename) || reader.size != SIZE) return false;
+    GameRecord game;
+    while (reader.next(game)) {
+        OthelloBoard board;
+        for (uint8_t move : game.moves) {
+            positions.push_back(board);
+            board.put_disc(Point(move / SIZE, move % SIZE));
+        }
+    }
+    return true;
+}
+
+// The PV is rebuilt by searching each position on the best line one ply shallower; with the same
+// evaluation point of view this follows the line the root search scored.
+std::vector<Point> principal_variation(OthelloBoard board, Point best, int depth) {
+    std::vector<Point> pv;
+    while (depth > 0 && !board.done && best != Point(-1, -1)) {
+        pv.push_back(best);
+        board.put_disc(best);
+        if (--depth == 0 || board.done) break;
+        best = MiniMax(board, depth, INT_MIN, INT_MAX).p;
+    }
+    return pv;
+}
+
+// Iterative deepening on MultiPV, which keeps the root order and `tt` between depths.
+Analysis analyze_multipv(const OthelloBoard& board, const AnalyzeConfig& config) {
+    Analysis result;
+    auto start = std::chrono::steady_clock::now();
+    int max_depth = config.movetime ? board.disc_count[OthelloBoard::EMPTY] : config.depth;
+    for (int depth = 1; depth <= max_depth; depth++) {
+        auto iteration = std::chrono::steady_clock::now();
+        MultiPV(board, depth, config.multipv, result.lines);
+        result.depth = depth;
+        if (config.movetime == 0) continue;
+        auto now = std::chrono::steady_clock::now();
+        double last = std::chrono::duration<double, std::milli>(now - iteration).count();
+        double elapsed = std::chrono::duration<double, std::milli>(now - start).count();
+        if (elapsed + last * 4 > config.movetime) break;
+    }
+    result.lines.resize(std::min<size_t>(config.multipv, result.lines.size()));
+    result.score = result.lines[0].score;
+    result.pv = result.lines[0].pv;
+    return result;
+}
+
+Analysis analyze(const OthelloBoard& board, const AnalyzeConfig& config) {
+    player = board.cur_player;
+    if (config.multipv > 1) return analyze_multipv(board, config);
+    Analysis result;
+    if (config.movetime == 0) {
+        PointValue best = MiniMax(board, config.depth, INT_MIN, INT_MAX);
+        result.depth = config.depth;
+        result.score = best.score;
+        result.pv = principal_variation(board, best.p, config.depth);
+        return result;
+    }
+    // Deepen while the next iteration is expected to finish in time.
+    auto start = std::chrono::steady_clock::now();
+    PointValue best;
+    double last = 0;
+    int max_depth = board.disc_count[OthelloBoard::EMPTY];
+    for (int depth = 1; depth <= max_depth; depth++) {
+        auto iteration = std::chrono::steady_clock::now();
+        best = MiniMax(board, depth, INT_MIN, INT_MAX);
+        result.depth = depth;
+        auto now = std::chrono::steady_clock::now();
+        last = std::chrono::duration<double, std::milli>(now - iteration).count();
+        double elapsed = std::chrono::duration<double, std::milli>(now - start).count();
+        if (elapsed + last * 4 > config.movetime) break;
+    }
+    result.score = best.score;
+    result.pv = principal_variation(board, best.p, result.depth);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    AnalyzeConfig config;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 < argc && arg == "-d") config.depth = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "-m") config.movetime = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "-t") config.threads = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "-k") config.multipv = atoi(argv[++i]);
+        else config.input = arg;
+    }
+    if (config.input.empty() || config.depth < 0 || config.movetime < 0 || config.threads < 1 || config.multipv < 1) {
+        std::cerr << "usage: " << argv[0] << " <positions> [-d depth | -m movetime_ms] [-t threads] [-k moves]\n";
+        return 1;
+    }
+    const char* nnue_file = getenv("ALPHAOTHELLO_NNUE");
+    nnue_load(nnue_file ? nnue_file : NNUE_FILE);
+    const char* weights_file = getenv("ALPHAOTHELLO_WEIGHTS");
+    load_params(weights_file ? weights_file : WEIGHTS_FILE, eval_params);
+    if (config.depth == 0) config.depth = search_params.depth;
+    // Multi-PV reads its PVs from the hash table (shared by all threads).
+    if (config.multipv > 1) tt.allocate(TT_MB);
+
+    std::vector<OthelloBoard> positions;
+    GameReader record;
+    if (record.open(config.input) && record.size != SIZE) {
+        std::cerr << "Not an 8x8 game record: " << config.input << "\n";
+        return 1;
+    }
+    if (!read_games(config.input, positions) && !read_states(config.input, positions)) {
+        std::cerr << "Error reading positions: " << config.input << "\n";
+        return 1;
+    }
+    if (positions.empty()) {
+        std::cerr << "No positions with a move to play in " << config.input << "\n";
+        return 1;
+    }
+
+    std::vector<Analysis> results(positions.size());
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < config.threads; t++) {
+        threads.emplace_back([&]() {
+            for (size_t i = next++; i < positions.size(); i = next++)
+                results[i] = analyze(positions[i], config);
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    for (size_t i = 0; i < positions.size(); i++) {
+        const Analysis& a = results[i];
+        if (config.multipv > 1) {
+            for (size_t r = 0; r < a.lines.size(); r++) {
+                const RootMove& line = a.lines[r];
+                std::cout << i << " " << (positions[i].cur_player == OthelloBoard::BLACK ? "O" : "X")
+                          << " depth " << a.depth << " multipv " << r + 1 << " score " << line.score
+                          << (line.exact ? "" : " upperbound") << " best (" << line.move.x << "," << line.move.y << ") pv";
+                for (Point p : line.pv)
+                    std::cout << " (" << p.x << "," << p.y << ")";
+                std::cout << "\n";
+            }
+            continue;
+        }
+        std::cout << i << " " << (positions[i].cur_player == OthelloBoard::BLACK ? "O" : "X")
+                  << " depth " << a.depth << " score " << a.score << " best ";
+        if (a.pv.empty()) std::cout << "(-1,-1)";
+        else std::cout << "(" << a.pv[0].x << "," << a.pv[0].y << ")";
+        std::cout << " pv";
+        for (Point p : a.pv)
+            std::cout << " (" << p.x << "," << p.y << ")";
+        std::cout << "\n";
+    }
+    return 0;
+}
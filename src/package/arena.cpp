@@ -0,0 +1,231 @@
+// Arena: plays many games at once on a fixed pool of threads, engine A against engine B.
+// Every search is a ResumableSearch that runs for a slice of nodes and then goes back in the queue,
+// so hundreds of games share a few cores without a thread each. Moves are limited by a node budget
+// per side (iterative deepening, the last finished depth is played), which makes every game
+// reproducible whatever the load or the number of threads. Time is measured per side, not enforced.
+//
+//   ./arena [-n games] [-c concurrent games] [-t threads] [-A nodes] [-B nodes] [-q slice nodes]
+//           [-r random plies] [-s seed] [-o record]
+
+#define ALPHAOTHELLO_NO_MAIN
+#include "player_new.cpp"
+#include "gamerecord.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+
+struct ArenaConfig {
+    int games = 100;
+    int concurrent = 256;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    long nodes[2] = {20000, 20000}; // per move, A and B
+    long slice = 2000;
+    int random_plies = 8;
+    unsigned seed = 1;
+    std::string output;
+};
+
+struct Game {
+    int index;
+    OthelloBoard board;
+    GameRecord record;
+    std::mt19937 rng;
+    int random_plies;
+    int a_colour; // A plays black in even games
+    // Current move: depth being searched, nodes spent on it, best move of the last finished depth.
+    ResumableSearch<8> search;
+    int depth = 0;
+    long move_nodes = 0;
+    PointValue best;
+    // Per engine (0 = A, 1 = B).
+    double seconds[2] = {};
+    long nodes[2] = {};
+    int moves[2] = {};
+};
+
+struct ArenaStats {
+    int wins = 0, draws = 0, losses = 0; // for A
+    double seconds[2] = {};
+    long nodes[2] = {};
+    int moves[2] = {};
+};
+
+ArenaConfig config;
+std::mutex queue_mutex;
+std::condition_variable queue_cv;
+std::deque<Game*> queue;
+int in_flight = 0;
+int games_started = 0;
+std::mutex results_mutex;
+ArenaStats stats;
+GameWriter writer;
+
+void new_game(Game& game, int index) {
+    game.index = index;
+    game.board = OthelloBoard();
+    game.record = GameRecord();
+    game.rng.seed(config.seed * 7919 + index);
+    game.random_plies = config.random_plies - (int)(game.rng() % (config.random_plies / 2 + 1));
+    game.a_colour = index % 2 == 0 ? OthelloBoard::BLACK : OthelloBoard::WHITE;
+    game.depth = 0;
+    std::fill(game.seconds, game.seconds + 2, 0.0);
+    std::fill(game.nodes, game.nodes + 2, 0L);
+    std::fill(game.moves, game.moves + 2, 0);
+}
+
+void play_move(Game& game, Point move, int score) {
+    game.record.moves.push_back(move.x * SIZE + move.y);
+    game.record.scores.push_back(std::min(std::max(score, -32767), 32767));
+    game.board.put_disc(move);
+    game.depth = 0;
+}
+
+// Runs one slice of the game. Only node counts decide when a move is played, never the clock.
+void advance(Game& game) {
+    long slice = config.slice;
+    while (slice > 0 && !game.board.done) {
+        if ((int)game.record.moves.size() < game.random_plies) {
+            game.record.random_plies++;
+            play_move(game, game.board.next_valid_spots[game.rng() % game.board.next_valid_spots.size()], 0);
+            continue;
+        }
+        int side = game.board.cur_player == game.a_colour ? 0 : 1;
+        long budget = config.nodes[side];
+        if (game.depth == 0) {
+            game.depth = 1;
+            game.move_nodes = 0;
+            game.best = PointValue(static_best_move<8>(game.board.next_valid_spots), 0);
+            game.search.start(game.board, 1, game.board.cur_player);
+        }
+        // Depth 1 always finishes, deeper iterations stop exactly at the budget.
+        long limit = game.depth == 1 ? slice : std::min(slice, budget - game.move_nodes);
+        long before = game.search.nodes();
+        auto start = std::chrono::steady_clock::now();
+        bool finished = game.search.run(limit);
+        game.seconds[side] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        long used = game.search.nodes() - before;
+        game.move_nodes += used;
+        game.nodes[side] += used;
+        slice -= std::max(used, 1L);
+        if (finished) game.best = game.search.result();
+        // The budget only applies once depth 1 has given a move.
+        bool out_of_nodes = game.move_nodes >= budget && (finished || game.depth > 1);
+        if (finished && !out_of_nodes && game.depth < game.board.disc_count[OthelloBoard::EMPTY]) {
+            game.search.start(game.board, ++game.depth, game.board.cur_player);
+        } else if (finished || out_of_nodes) {
+            game.moves[side]++;
+            play_move(game, game.best.p, game.best.score);
+        }
+    }
+}
+
+void finish(Game& game) {
+    int result = game.board.disc_count[OthelloBoard::BLACK] - game.board.disc_count[OthelloBoard::WHITE];
+    game.record.result = result;
+    if (game.a_colour == OthelloBoard::WHITE) result = -result;
+    std::lock_guard<std::mutex> lock(results_mutex);
+    if (result > 0) stats.wins++;
+    else if (result < 0) stats.losses++;
+    else stats.draws++;
+    for (int side = 0; side < 2; side++) {
+        stats.seconds[side] += game.seconds[side];
+        stats.nodes[side] += game.nodes[side];
+        stats.moves[side] += game.moves[side];
+    }
+    if (!config.output.empty()) {
+        std::string buf;
+        GameWriter::encode(game.record, buf);
+        writer.write(buf);
+    }
+}
+
+void worker() {
+    while (true) {
+        Game* game;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_cv.wait(lock, []() { return !queue.empty() || in_flight == 0; });
+            if (queue.empty()) return;
+            game = queue.front();
+            queue.pop_front();
+        }
+        advance(*game);
+        if (game->board.done) {
+            finish(*game);
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            if (games_started < config.games) {
+                new_game(*game, games_started++);
+                queue.push_back(game);
+            } else {
+                delete game;
+                in_flight--;
+                queue_cv.notify_all();
+                continue;
+            }
+        } else {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            queue.push_back(game);
+        }
+        queue_cv.notify_one();
+    }
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 < argc && arg == "-n") config.games = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "-c") config.concurrent = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "-t") config.threads = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "-A") config.nodes[0] = atol(argv[++i]);
+        else if (i + 1 < argc && arg == "-B") config.nodes[1] = atol(argv[++i]);
+        else if (i + 1 < argc && arg == "-q") config.slice = atol(argv[++i]);
+        else if (i + 1 < argc && arg == "-r") config.random_plies = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "-s") config.seed = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "-o") config.output = argv[++i];
+        else config.games = -1;
+    }
+    if (config.games < 1 || config.concurrent < 1 || config.threads < 1 || config.nodes[0] < 1
+        || config.nodes[1] < 1 || config.slice < 1 || config.random_plies < 0) {
+        std::cerr << "usage: " << argv[0] << " [-n games] [-c concurrent games] [-t threads] [-A nodes] [-B nodes]"
+                  << " [-q slice nodes] [-r random plies] [-s seed] [-o record]\n";
+        return 1;
+    }
+    const char* nnue_file = getenv("ALPHAOTHELLO_NNUE");
+    nnue_load(nnue_file ? nnue_file : NNUE_FILE);
+    const char* weights_file = getenv("ALPHAOTHELLO_WEIGHTS");
+    load_params(weights_file ? weights_file : WEIGHTS_FILE, eval_params);
+    if (!config.output.empty() && !writer.open(config.output)) {
+        std::cerr << "Error opening file: " << config.output << "\n";
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (; games_started < std::min(config.games, config.concurrent); games_started++) {
+        Game* game = new Game;
+        new_game(*game, games_started);
+        queue.push_back(game);
+        in_flight++;
+    }
+    std::vector<std::thread> threads;
+    for (int i = 0; i < config.threads; i++)
+        threads.emplace_back(worker);
+    for (auto& t : threads)
+        t.join();
+    writer.close();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int games = stats.wins + stats.draws + stats.losses;
+    std::cout << "A +" << stats.wins << " =" << stats.draws << " -" << stats.losses << " ("
+              << 100.0 * (stats.wins + 0.5 * stats.draws) / games << "%)\n";
+    for (int side = 0; side < 2; side++) {
+        std::cout << (side == 0 ? "A" : "B") << ": " << stats.moves[side] << " moves, "
+                  << stats.nodes[side] / std::max(stats.moves[side], 1) << " nodes/move, "
+                  << 1000 * stats.seconds[side] / std::max(stats.moves[side], 1) << " ms/move\n";
+    }
+    std::cout << games << " games in " << seconds << "s ("
+              << (long)((stats.nodes[0] + stats.nodes[1]) / seconds) << " nodes/s)\n";
+    return 0;
+}
@@ -0,0 +1,96 @@
+#ifndef GAMERECORD_H
+#define GAMERECORD_H
+
+// Compact binary game records written by selfplay and read by the offline tools.
+//
+// File:   char magic[4] = "AOGR", uint8 version, uint8 board size, uint16 reserved
+// Game:   uint8 n_moves, int8 result (black discs - white discs), uint8 random_plies
+//         then n_moves x { uint8 move (x * size + y), int16 score }
+// `score` is the search score of the position before the move, from the mover's point of view
+// (0 for the random opening plies). Passes are not stored: replaying the moves with
+// OthelloBoard::put_disc passes automatically.
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+struct GameRecord {
+    int8_t result = 0;
+    uint8_t random_plies = 0;
+    std::vector<uint8_t> moves;
+    std::vector<int16_t> scores;
+};
+
+const char GAMERECORD_MAGIC[4] = {'A', 'O', 'G', 'R'};
+const uint8_t GAMERECORD_VERSION = 1;
+
+class GameWriter {
+public:
+    bool open(const std::string& filename, int size = 8) {
+        fout.open(filename, std::ios::binary | std::ios::trunc);
+        if (!fout) return false;
+        uint8_t header[8] = {'A', 'O', 'G', 'R', GAMERECORD_VERSION, (uint8_t)size, 0, 0};
+        fout.write((const char*)header, sizeof(header));
+        return (bool)fout;
+    }
+    // Appends the encoded game to `buf`, so threads can batch games before writing.
+    static void encode(const GameRecord& game, std::string& buf) {
+        buf.push_back((char)game.moves.size());
+        buf.push_back((char)game.result);
+        buf.push_back((char)game.random_plies);
+        for (size_t i = 0; i < game.moves.size(); i++) {
+            uint16_t score = (uint16_t)game.scores[i];
+            buf.push_back((char)game.moves[i]);
+            buf.push_back((char)(score & 0xff));
+            buf.push_back((char)(score >> 8));
+        }
+    }
+    bool write(const std::string& encoded) {
+        fout.write(encoded.data(), encoded.size());
+        return (bool)fout;
+    }
+    void close() {
+        fout.close();
+    }
+private:
+    std::ofstream fout;
+};
+
+// Streaming reader, only one game is held in memory at a time.
+class GameReader {
+public:
+    int size = 0;
+    bool open(const std::string& filename) {
+        fin.open(filename, std::ios::binary);
+        uint8_t header[8];
+        if (!fin.read((char*)header, sizeof(header))) return false;
+        if (std::string((const char*)header, 4) != std::string(GAMERECORD_MAGIC, 4)) return false;
+        if (header[4] != GAMERECORD_VERSION) return false;
+        size = header[5];
+        return true;
+    }
+    bool next(GameRecord& game) {
+        uint8_t head[3];
+        if (!fin.read((char*)head, sizeof(head))) return false;
+        game.result = (int8_t)head[1];
+        game.random_plies = head[2];
+        game.moves.resize(head[0]);
+        game.scores.resize(head[0]);
+        buf.resize(3 * head[0]);
+        if (!fin.read((char*)buf.data(), buf.size())) return false;
+        for (int i = 0; i < head[0]; i++) {
+            game.moves[i] = buf[3 * i];
+            game.scores[i] = (int16_t)(buf[3 * i + 1] | (buf[3 * i + 2] << 8));
+        }
+        return true;
+    }
+    void close() {
+        fin.close();
+    }
+private:
+    std::ifstream fin;
+    std::vector<uint8_t> buf;
+};
+
+#endif
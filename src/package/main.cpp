@@ -5,6 +5,8 @@
 #include <array>
 #include <vector>
 #include <cassert>
+#include <chrono>
+#include <cmath>
 
 struct Point {
     int x, y;
@@ -24,6 +26,8 @@ struct Point {
 	}
 };
 
+// Board size is a template parameter: 6x6, 8x8 (the main game) and 10x10 variants.
+template<int N>
 class OthelloBoard {
 public:
     enum SPOT_STATE {
@@ -31,7 +35,7 @@ public:
         BLACK = 1,
         WHITE = 2
     };
-    static const int SIZE = 8;
+    static const int SIZE = N;
     const std::array<Point, 8> directions{{
         Point(-1, -1), Point(-1, 0), Point(-1, 1),
         Point(0, -1), /*{0, 0}, */Point(0, 1),
@@ -112,10 +116,11 @@ public:
                 board[i][j] = EMPTY;
             }
         }
-        board[3][4] = board[4][3] = BLACK;
-        board[3][3] = board[4][4] = WHITE;
+        const int c = SIZE / 2;
+        board[c-1][c] = board[c][c-1] = BLACK;
+        board[c-1][c-1] = board[c][c] = WHITE;
         cur_player = BLACK;
-        disc_count[EMPTY] = 8*8-4;
+        disc_count[EMPTY] = SIZE*SIZE-4;
         disc_count[BLACK] = 2;
         disc_count[WHITE] = 2;
         next_valid_spots = get_valid_spots();
@@ -175,19 +180,20 @@ public:
         if (board[x][y] == WHITE) return "X";
         return " ";
     }
-    std::string encode_output(bool fail=false) {
+    // `fail` is why the game ended early (invalid move, out of time), the winner is already set.
+    std::string encode_output(const std::string& fail = "") {
         int i, j;
         std::stringstream ss;
-        ss << "Timestep #" << (8*8-4-disc_count[EMPTY]+1) << "\n";
+        ss << "Timestep #" << (SIZE*SIZE-4-disc_count[EMPTY]+1) << "\n";
         ss << "O: " << disc_count[BLACK] << "; X: " << disc_count[WHITE] << "\n";
-        if (fail) {
-            ss << "Winner is " << encode_player(winner) << " (Opponent performed invalid move)\n";
+        if (!fail.empty()) {
+            ss << "Winner is " << encode_player(winner) << " (" << fail << ")\n";
         } else if (next_valid_spots.size() > 0) {
             ss << encode_player(cur_player) << "'s turn\n";
         } else {
             ss << "Winner is " << encode_player(winner) << "\n";
         }
-        ss << "+---------------+\n";
+        ss << "+" << std::string(2*SIZE-1, '-') << "+\n";
         for (i = 0; i < SIZE; i++) {
             ss << "|";
             for (j = 0; j < SIZE-1; j++) {
@@ -195,7 +201,7 @@ public:
             }
             ss << encode_spot(i, j) << "|\n";
         }
-        ss << "+---------------+\n";
+        ss << "+" << std::string(2*SIZE-1, '-') << "+\n";
         ss << next_valid_spots.size() << " valid moves: {";
         if (next_valid_spots.size() > 0) {
             Point p = next_valid_spots[0];
@@ -209,7 +215,8 @@ public:
         ss << "=================\n";
         return ss.str();
     }
-    std::string encode_state() {
+    // The clock line at the end is ignored by players that stop after the valid spots.
+    std::string encode_state(const std::string& clock) {
         int i, j;
         std::stringstream ss;
         ss << cur_player << "\n";
@@ -224,8 +231,16 @@ public:
             Point p = next_valid_spots[i];
             ss << p.x << " " << p.y << "\n";
         }
+        ss << clock << "\n";
         return ss.str();
     }
+    int move_number() const {
+        return SIZE*SIZE-4-disc_count[EMPTY]+1;
+    }
+    void lose_on_time() {
+        winner = get_next_player(cur_player);
+        done = true;
+    }
 };
 
 const std::string file_log = "gamelog.txt";
@@ -234,44 +249,85 @@ const std::string file_action = "action";
 // Timeout is set to 10 when TA test your code.
 const int timeout = 10;
 
-void launch_executable(std::string filename) {
+// Either a fixed time per move (the player is killed after it and its last written move counts),
+// or a bank per side plus an increment after every move (the player loses when the bank runs out).
+struct TimeControl {
+    bool bank = false;
+    double seconds = timeout; // per move, or the initial bank
+    double increment = 0;
+};
+
+// "10" is 10 seconds per move, "300+5" a 300 second bank with 5 seconds added after each move.
+bool parse_time_control(const std::string& text, TimeControl& tc) {
+    std::stringstream ss(text);
+    char plus;
+    if (!(ss >> tc.seconds) || tc.seconds <= 0) return false;
+    tc.bank = (bool)(ss >> plus);
+    if (tc.bank && (plus != '+' || !(ss >> tc.increment) || tc.increment < 0)) return false;
+    return true;
+}
+
+long to_ms(double seconds) {
+    return (long)(seconds * 1000);
+}
+
+void launch_executable(std::string filename, double limit) {
 #if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
     std::string command = "start /min " + filename + " " + file_state + " " + file_action;
-    std::string kill = "timeout /t " + std::to_string(timeout) + " > NUL && taskkill /im " + filename + " > NUL 2>&1";
+    std::string kill = "timeout /t " + std::to_string((int)std::ceil(limit)) + " > NUL && taskkill /im " + filename + " > NUL 2>&1";
     system(command.c_str());
     system(kill.c_str());
 #elif __linux__
-    std::string command = "timeout " + std::to_string(timeout) + "s " + filename + " " + file_state + " " + file_action;
+    std::string command = "timeout " + std::to_string(limit) + "s " + filename + " " + file_state + " " + file_action;
     system(command.c_str());
 #elif __APPLE__
 //     May require installing the command by:
 //     brew install coreutils
-    std::string command = "gtimeout " + std::to_string(timeout) + "s " + filename + " " + file_state + " " + file_action;
+    std::string command = "gtimeout " + std::to_string(limit) + "s " + filename + " " + file_state + " " + file_action;
     system(command.c_str());
 #endif
 }
 
-int main(int argc, char** argv) {
-    assert(argc == 3);
+template<int N>
+void run_game(const std::string player_filename[3], const TimeControl& tc) {
     std::ofstream log("gamelog.txt");
-    std::string player_filename[3];
-    player_filename[1] = argv[1];
-    player_filename[2] = argv[2];
-    std::cout << "Player Black File: " << player_filename[OthelloBoard::BLACK] << std::endl;
-    std::cout << "Player White File: " << player_filename[OthelloBoard::WHITE] << std::endl;
-    OthelloBoard game;
+    std::cout << "Player Black File: " << player_filename[OthelloBoard<N>::BLACK] << std::endl;
+    std::cout << "Player White File: " << player_filename[OthelloBoard<N>::WHITE] << std::endl;
+    OthelloBoard<N> game;
+    double bank[3] = {0, tc.seconds, tc.seconds};
     std::string data;
     data = game.encode_output();
     std::cout << data;
     log << data;
     while (!game.done) {
-        // Output current state
-        data = game.encode_state();
+        // Output current state, with "time <own ms> <opponent ms> <increment ms> <move>" for a bank
+        // or "movetime <ms> <move>" for a fixed time per move.
+        int me = game.cur_player;
+        std::stringstream clock;
+        if (tc.bank) clock << "time " << to_ms(bank[me]) << " " << to_ms(bank[3 - me]) << " " << to_ms(tc.increment) << " ";
+        else clock << "movetime " << to_ms(tc.seconds) << " ";
+        clock << game.move_number();
+        data = game.encode_state(clock.str());
         std::ofstream fout(file_state);
         fout << data;
         fout.close();
         // Run external program
-        launch_executable(player_filename[game.cur_player]);
+        double limit = tc.bank ? bank[me] : tc.seconds;
+        auto start = std::chrono::steady_clock::now();
+        launch_executable(player_filename[me], limit);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (tc.bank) {
+            bank[me] -= elapsed;
+            if (bank[me] <= 0) {
+                remove(file_action.c_str());
+                game.lose_on_time();
+                data = game.encode_output("Opponent ran out of time");
+                std::cout << data;
+                log << data;
+                break;
+            }
+            bank[me] += tc.increment;
+        }
         // Read action
         std::ifstream fin(file_action);
         Point p(-1, -1);
@@ -288,12 +344,17 @@ int main(int argc, char** argv) {
         // Take action
         if (!game.put_disc(p)) {
             // If action is invalid.
-            data = game.encode_output(true);
+            data = game.encode_output("Opponent performed invalid move");
             std::cout << data;
             log << data;
             break;
         }
         data = game.encode_output();
+        if (tc.bank) {
+            std::stringstream ss;
+            ss << "Clock O: " << bank[OthelloBoard<N>::BLACK] << "s; X: " << bank[OthelloBoard<N>::WHITE] << "s\n";
+            data += ss.str();
+        }
         std::cout << data;
         log << data;
     }
@@ -301,5 +362,26 @@ int main(int argc, char** argv) {
     // Reset state file
     if (remove(file_state.c_str()) != 0)
         std::cerr << "Error removing file: " << file_state << "\n";
+}
+
+// Usage: main <black player> <white player> [board size: 6, 8 or 10] [time control: 10 | 300+5]
+int main(int argc, char** argv) {
+    assert(argc >= 3 && argc <= 5);
+    std::string player_filename[3];
+    player_filename[1] = argv[1];
+    player_filename[2] = argv[2];
+    int size = argc >= 4 ? atoi(argv[3]) : 8;
+    TimeControl tc;
+    if (argc == 5 && !parse_time_control(argv[4], tc)) {
+        std::cerr << "Invalid time control: " << argv[4] << "\n";
+        return 1;
+    }
+    if (size == 6) run_game<6>(player_filename, tc);
+    else if (size == 8) run_game<8>(player_filename, tc);
+    else if (size == 10) run_game<10>(player_filename, tc);
+    else {
+        std::cerr << "Unsupported board size: " << size << "\n";
+        return 1;
+    }
     return 0;
 }
@@ -8,11 +8,37 @@
 #include <sstream>
 #include <cassert>
 #include <algorithm>
+#include <functional>
 #include <climits>
+#include <cstdint>
+#include <csignal>
+#include <cstring>
+#include <cctype>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NNUE_X86 1
+#endif
 
 #define DEPTH 6
-#define diffCTR 4
-#define cornerCTR 10
+#define NNUE_FILE "nnue.bin"
+#define WEIGHTS_FILE "weights.txt"
+#define TT_MB 64
+#define ENDGAME_EMPTIES 20
+#define CACHE_FILE "player_new.cache"
+#define PONDER_LIFETIME 30
 
 
 struct Point {
@@ -33,25 +59,312 @@ struct Point {
 	}
 };
 
-class OthelloBoard {
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Profiling scopes, only with -DPROFILE (`make PROFILE=1`); otherwise PROFILE_SCOPE expands to nothing.
+// Each scope moves the main thread to its node of a preallocated call-stack trie, so the same function
+// called from different places is kept apart. Time is sampled rather than read in every scope: the
+// hot functions are so short that two clock reads each cost more than the functions themselves.
+// SIGPROF fires every PROFILE_INTERVAL_US of CPU time and charges the sample to the current node.
+// profile_dump() writes the trie as folded stacks ("MiniMax;put_disc;flip_discs 12", self samples) for
+// flamegraph.pl, appending to ALPHAOTHELLO_PROFILE (default profile.folded) at exit or from the
+// deadline handler, so the formatting is done by hand into a static buffer and written with write().
+#ifdef PROFILE
+const int PROFILE_NODES = 4096;
+const int PROFILE_INTERVAL_US = 250;
+
+struct ProfileNode {
+    const char* name;
+    int parent, child, sibling;
+    uint64_t samples, calls;
+};
+
+ProfileNode profile_nodes[PROFILE_NODES] = {{"all", -1, -1, -1, 0, 0}};
+int profile_count = 1;
+volatile int profile_current = 0;
+int profile_fd = -1;
+thread_local bool profile_thread = false;
+
+struct ProfileScope {
+    int saved = -1;
+    explicit ProfileScope(const char* name) {
+        if (!profile_thread) return;
+        int parent = profile_current, n = profile_nodes[parent].child;
+        while (n >= 0 && profile_nodes[n].name != name) n = profile_nodes[n].sibling;
+        if (n < 0) {
+            if (profile_count == PROFILE_NODES) return; // full, the samples stay with the caller
+            n = profile_count;
+            profile_nodes[n] = {name, parent, -1, profile_nodes[parent].child, 0, 0};
+            profile_nodes[parent].child = n;
+            profile_count++;
+        }
+        profile_nodes[n].calls++;
+        saved = parent;
+        profile_current = n;
+    }
+    ~ProfileScope() {
+        if (saved >= 0) profile_current = saved;
+    }
+};
+
+extern "C" void on_profile_sample(int) {
+    profile_nodes[profile_current].samples++;
+}
+
+void profile_open(const char* filename) {
+#ifndef _WIN32
+    profile_fd = open(filename, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    profile_thread = true;
+    signal(SIGPROF, on_profile_sample);
+    struct itimerval interval = {{0, PROFILE_INTERVAL_US}, {0, PROFILE_INTERVAL_US}};
+    setitimer(ITIMER_PROF, &interval, nullptr);
+#else
+    (void)filename;
+#endif
+}
+
+// Async-signal-safe: no allocation, no stdio.
+void profile_dump() {
+#ifndef _WIN32
+    if (profile_fd < 0) return;
+    static char buf[1 << 16];
+    size_t len = 0;
+    auto flush = [&]() {
+        if (write(profile_fd, buf, len) < 0) {}
+        len = 0;
+    };
+    for (int n = 0; n < profile_count; n++) {
+        uint64_t samples = profile_nodes[n].samples;
+        if (samples == 0) continue;
+        // Path from the root: collect the ancestors, then print them outermost first.
+        int path[PROFILE_NODES], depth = 0;
+        for (int a = n; a >= 0; a = profile_nodes[a].parent) path[depth++] = a;
+        if (len + 1024 > sizeof(buf)) flush();
+        for (int i = depth - 1; i >= 0; i--) {
+            for (const char* c = profile_nodes[path[i]].name; *c && len < sizeof(buf) - 32; c++) buf[len++] = *c;
+            buf[len++] = i ? ';' : ' ';
+            if (len + 64 > sizeof(buf)) flush();
+        }
+        char digits[24];
+        int nd = 0;
+        do digits[nd++] = '0' + samples % 10; while (samples /= 10);
+        while (nd) buf[len++] = digits[--nd];
+        buf[len++] = '\n';
+    }
+    flush();
+#endif
+}
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) static const char PROFILE_CONCAT(profile_name_, __LINE__)[] = name; \
+    ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(PROFILE_CONCAT(profile_name_, __LINE__))
+#else
+#define PROFILE_SCOPE(name)
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Optional NNUE-style evaluation.
+// Inputs are 128 features: one per (colour, square), own discs = 0..63, opponent discs = 64..127.
+// Each board keeps two int16 accumulators (black's and white's point of view) which are updated
+// whenever a disc is placed or flipped, so a leaf only pays for the small output layer.
+// The network is used by heuristic() when NNUE_FILE (or $ALPHAOTHELLO_NNUE) can be loaded.
+//
+// File layout (little endian):
+//   char magic[8] = "AONNUE01", int32 hidden (= NN_HIDDEN)
+//   int16 bias[NN_HIDDEN], int16 weight[NN_INPUTS][NN_HIDDEN]
+//   int8 out[2*NN_HIDDEN]   (side to move half first), int32 out_bias, int32 out_shift
+const int NN_INPUTS = 128;
+const int NN_HIDDEN = 32;
+const int NN_CLIP = 127;
+
+struct NNUE {
+    bool loaded = false;
+    alignas(32) int16_t bias[NN_HIDDEN];
+    alignas(32) int16_t weight[NN_INPUTS][NN_HIDDEN];
+    alignas(32) int8_t out[2 * NN_HIDDEN];
+    int32_t out_bias;
+    int32_t out_shift;
+    int32_t bound; // larger than any output, finished games score beyond it
+    // kernels, picked at load time
+    void (*acc_add)(int16_t* acc, const int16_t* w);
+    void (*acc_sub)(int16_t* acc, const int16_t* w);
+    int32_t (*propagate)(const int16_t* us, const int16_t* them, const int8_t* out);
+} nnue;
+
+static void acc_add_scalar(int16_t* acc, const int16_t* w) {
+    for (int i = 0; i < NN_HIDDEN; i++) acc[i] += w[i];
+}
+static void acc_sub_scalar(int16_t* acc, const int16_t* w) {
+    for (int i = 0; i < NN_HIDDEN; i++) acc[i] -= w[i];
+}
+static int32_t propagate_scalar(const int16_t* us, const int16_t* them, const int8_t* out) {
+    int32_t sum = 0;
+    for (int i = 0; i < NN_HIDDEN; i++) {
+        sum += std::min(std::max<int>(us[i], 0), NN_CLIP) * out[i];
+        sum += std::min(std::max<int>(them[i], 0), NN_CLIP) * out[NN_HIDDEN + i];
+    }
+    return sum;
+}
+
+#ifdef NNUE_X86
+__attribute__((target("avx2")))
+static void acc_add_avx2(int16_t* acc, const int16_t* w) {
+    for (int i = 0; i < NN_HIDDEN; i += 16) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(acc + i));
+        __m256i b = _mm256_load_si256((const __m256i*)(w + i));
+        _mm256_storeu_si256((__m256i*)(acc + i), _mm256_add_epi16(a, b));
+    }
+}
+__attribute__((target("avx2")))
+static void acc_sub_avx2(int16_t* acc, const int16_t* w) {
+    for (int i = 0; i < NN_HIDDEN; i += 16) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(acc + i));
+        __m256i b = _mm256_load_si256((const __m256i*)(w + i));
+        _mm256_storeu_si256((__m256i*)(acc + i), _mm256_sub_epi16(a, b));
+    }
+}
+__attribute__((target("avx2")))
+static int32_t propagate_avx2(const int16_t* us, const int16_t* them, const int8_t* out) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i clip = _mm256_set1_epi16(NN_CLIP);
+    __m256i sum = _mm256_setzero_si256();
+    for (int half = 0; half < 2; half++) {
+        const int16_t* acc = half ? them : us;
+        for (int i = 0; i < NN_HIDDEN; i += 16) {
+            __m256i a = _mm256_loadu_si256((const __m256i*)(acc + i));
+            a = _mm256_min_epi16(_mm256_max_epi16(a, zero), clip);
+            __m256i w = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(out + half * NN_HIDDEN + i)));
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(a, w));
+        }
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+#endif
+
+bool nnue_load(const char* filename) {
+    std::ifstream fin(filename, std::ios::binary);
+    if (!fin) return false;
+    char magic[8];
+    int32_t hidden = 0;
+    fin.read(magic, 8);
+    fin.read((char*)&hidden, sizeof(hidden));
+    if (!fin || std::string(magic, 8) != "AONNUE01" || hidden != NN_HIDDEN) return false;
+    fin.read((char*)nnue.bias, sizeof(nnue.bias));
+    fin.read((char*)nnue.weight, sizeof(nnue.weight));
+    fin.read((char*)nnue.out, sizeof(nnue.out));
+    fin.read((char*)&nnue.out_bias, sizeof(nnue.out_bias));
+    fin.read((char*)&nnue.out_shift, sizeof(nnue.out_shift));
+    // Any other shift is undefined behaviour on int32; the engine keeps corner() instead.
+    if (!fin || nnue.out_shift < 0 || nnue.out_shift > 31) return false;
+    int64_t largest = std::abs((int64_t)nnue.out_bias);
+    for (int i = 0; i < 2 * NN_HIDDEN; i++) largest += std::abs((int)nnue.out[i]) * NN_CLIP;
+    nnue.bound = (int32_t)(largest >> nnue.out_shift) + 1;
+    nnue.acc_add = acc_add_scalar;
+    nnue.acc_sub = acc_sub_scalar;
+    nnue.propagate = propagate_scalar;
+#ifdef NNUE_X86
+    if (__builtin_cpu_supports("avx2")) {
+        nnue.acc_add = acc_add_avx2;
+        nnue.acc_sub = acc_sub_avx2;
+        nnue.propagate = propagate_avx2;
+    }
+#endif
+    nnue.loaded = true;
+    return true;
+}
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Board size is a template parameter so the 6x6 / 10x10 variants get their own fully specialised code.
+// Squares are numbered x * N + y; 6x6 and 8x8 fit in a 64-bit bitboard, 10x10 needs 128 bits.
+template<int N, bool Small = (N * N <= 64)>
+struct BitboardType { typedef uint64_t type; };
+template<int N>
+struct BitboardType<N, false> { typedef unsigned __int128 type; };
+
+template<int N>
+struct Bitboards {
+    typedef typename BitboardType<N>::type Bits;
+    static constexpr Bits bit(int sq) {
+        return (Bits)1 << sq;
+    }
+    static constexpr Bits full() {
+        return N * N == 8 * (int)sizeof(Bits) ? ~(Bits)0 : bit(N * N) - 1;
+    }
+    static constexpr Bits column(int y) {
+        Bits b = 0;
+        for (int x = 0; x < N; x++) b |= bit(x * N + y);
+        return b;
+    }
+    // Shift every disc one step in direction (dx, dy), dropping the ones that leave the board.
+    template<int DX, int DY>
+    static Bits shift(Bits b) {
+        const int s = DX * N + DY;
+        constexpr Bits not_first = ~column(0) & full(), not_last = ~column(N - 1) & full();
+        b = s > 0 ? b << (s > 0 ? s : 0) : b >> (s < 0 ? -s : 0);
+        if (DY == 1) return b & not_first;
+        if (DY == -1) return b & not_last;
+        return b & full();
+    }
+    template<int DX, int DY>
+    static Bits moves_dir(Bits P, Bits O, Bits empty) {
+        Bits x = shift<DX, DY>(P) & O;
+        for (int i = 0; i < N - 3; i++) x |= shift<DX, DY>(x) & O;
+        return shift<DX, DY>(x) & empty;
+    }
+    static Bits moves(Bits P, Bits O) {
+        Bits empty = ~(P | O) & full();
+        return moves_dir<-1, -1>(P, O, empty) | moves_dir<-1, 0>(P, O, empty) | moves_dir<-1, 1>(P, O, empty)
+             | moves_dir<0, -1>(P, O, empty) | moves_dir<0, 1>(P, O, empty)
+             | moves_dir<1, -1>(P, O, empty) | moves_dir<1, 0>(P, O, empty) | moves_dir<1, 1>(P, O, empty);
+    }
+    template<int DX, int DY>
+    static Bits flips_dir(Bits m, Bits P, Bits O) {
+        Bits f = 0, x = shift<DX, DY>(m);
+        while (x & O) {
+            f |= x;
+            x = shift<DX, DY>(x);
+        }
+        return (x & P) ? f : 0;
+    }
+    static Bits flips(Bits m, Bits P, Bits O) {
+        return flips_dir<-1, -1>(m, P, O) | flips_dir<-1, 0>(m, P, O) | flips_dir<-1, 1>(m, P, O)
+             | flips_dir<0, -1>(m, P, O) | flips_dir<0, 1>(m, P, O)
+             | flips_dir<1, -1>(m, P, O) | flips_dir<1, 0>(m, P, O) | flips_dir<1, 1>(m, P, O);
+    }
+    static int lowest(Bits b) {
+        uint64_t lo = (uint64_t)b;
+        return lo ? __builtin_ctzll(lo) : 64 + __builtin_ctzll((uint64_t)(b >> (N * N > 64 ? 64 : 0)));
+    }
+    static int count(Bits b) {
+        return __builtin_popcountll((uint64_t)b) + (N * N > 64 ? __builtin_popcountll((uint64_t)(b >> (N * N > 64 ? 64 : 0))) : 0);
+    }
+};
+
+template<int N>
+class BasicOthelloBoard {
 public:
     enum SPOT_STATE {
         EMPTY = 0,
         BLACK = 1,
         WHITE = 2
     };
-    static const int SIZE = 8;
-    const std::array<Point, 8> directions{{
-        Point(-1, -1), Point(-1, 0), Point(-1, 1),
-        Point(0, -1), /*{0, 0}, */Point(0, 1),
-        Point(1, -1), Point(1, 0), Point(1, 1)
-    }};
+    static const int SIZE = N;
+    typedef Bitboards<N> BB;
+    typedef typename BB::Bits Bits;
     std::array<std::array<int, SIZE>, SIZE> board;
+    Bits bits[3];   // bits[BLACK] / bits[WHITE], kept in sync with board
     std::vector<Point> next_valid_spots;
     std::array<int, 3> disc_count;
     int cur_player;
     bool done;
     int winner;
+    // [BLACK-1] / [WHITE-1] point of view, 8x8 only. Not over-aligned: boards also live in containers,
+    // which ignore alignas before C++17, so the kernels load it unaligned.
+    int16_t accumulator[2][NN_HIDDEN];
 private:
     int get_next_player(int player) const {
         return 3 - player;  //player black = 1, player white = 2
@@ -59,73 +372,61 @@ private:
     bool is_spot_on_board(Point p) const {
         return 0 <= p.x && p.x < SIZE && 0 <= p.y && p.y < SIZE;
     }
-    int get_disc(Point p) const {
-        return board[p.x][p.y];
-    }
     void set_disc(Point p, int disc) {
+        int sq = p.x * SIZE + p.y;
+        int old = board[p.x][p.y];
+        if (N == 8 && nnue.loaded) {
+            if (old != EMPTY) {
+                nnue.acc_sub(accumulator[0], nnue.weight[(old == BLACK ? 0 : 64) + sq]);
+                nnue.acc_sub(accumulator[1], nnue.weight[(old == WHITE ? 0 : 64) + sq]);
+            }
+            nnue.acc_add(accumulator[0], nnue.weight[(disc == BLACK ? 0 : 64) + sq]);
+            nnue.acc_add(accumulator[1], nnue.weight[(disc == WHITE ? 0 : 64) + sq]);
+        }
+        bits[old] &= ~BB::bit(sq);
+        bits[disc] |= BB::bit(sq);
         board[p.x][p.y] = disc;
     }
-    bool is_disc_at(Point p, int disc) const {
-        if (!is_spot_on_board(p))
-            return false;
-        if (get_disc(p) != disc)
-            return false;
-        return true;
+    Bits legal_moves() const {
+        return BB::moves(bits[cur_player], bits[get_next_player(cur_player)]);
     }
-    bool is_spot_valid(Point center) const { //check trhu 8 directions whether the spot is valid or not
-        if (get_disc(center) != EMPTY)
+    bool is_spot_valid(Point center) const {
+        if (!is_spot_on_board(center))
             return false;
-        for (Point dir: directions) {
-            // Move along the direction while testing.
-            Point p = center + dir;
-            if (!is_disc_at(p, get_next_player(cur_player)))
-                continue;
-            p = p + dir;
-            while (is_spot_on_board(p) && get_disc(p) != EMPTY) {
-                if (is_disc_at(p, cur_player))
-                    return true;
-                p = p + dir;
-            }
-        }
-        return false;
+        return (legal_moves() & BB::bit(center.x * SIZE + center.y)) != 0;
     }
     void flip_discs(Point center) {
-        for (Point dir: directions) {
-            // Move along the direction while testing.
-            Point p = center + dir;
-            if (!is_disc_at(p, get_next_player(cur_player)))
-                continue;
-            std::vector<Point> discs({p});
-            p = p + dir;
-            while (is_spot_on_board(p) && get_disc(p) != EMPTY) {
-                if (is_disc_at(p, cur_player)) {
-                    for (Point s: discs) {
-                        set_disc(s, cur_player);
-                    }
-                    disc_count[cur_player] += discs.size();
-                    disc_count[get_next_player(cur_player)] -= discs.size();
-                    break;
-                }
-                discs.push_back(p);
-                p = p + dir;
-            }
+        PROFILE_SCOPE("flip_discs");
+        Bits flips = BB::flips(BB::bit(center.x * SIZE + center.y), bits[cur_player], bits[get_next_player(cur_player)]);
+        int n = BB::count(flips);
+        for (; flips; flips &= flips - 1) {
+            int sq = BB::lowest(flips);
+            set_disc(Point(sq / SIZE, sq % SIZE), cur_player);
         }
+        disc_count[cur_player] += n;
+        disc_count[get_next_player(cur_player)] -= n;
     }
 public:
-    OthelloBoard() {
+    BasicOthelloBoard() {
         reset();
     }
-    OthelloBoard(const OthelloBoard& copy){
-        for (int i = 0; i < SIZE; i++) {
-            for (int j = 0; j < SIZE; j++) {
-                board[i][j] = copy.board[i][j];
-            }
-        }
+    BasicOthelloBoard(const BasicOthelloBoard& copy){
+        *this = copy;
+    }
+    BasicOthelloBoard& operator=(const BasicOthelloBoard& copy) {
+        PROFILE_SCOPE("board_copy");
+        board = copy.board;
+        bits[EMPTY] = copy.bits[EMPTY];
+        bits[BLACK] = copy.bits[BLACK];
+        bits[WHITE] = copy.bits[WHITE];
         cur_player = copy.cur_player;
         disc_count = copy.disc_count;
         next_valid_spots = copy.next_valid_spots;
         done = copy.done;
         winner = copy.winner;
+        if (N == 8 && nnue.loaded)
+            std::copy(&copy.accumulator[0][0], &copy.accumulator[0][0] + 2 * NN_HIDDEN, &accumulator[0][0]);
+        return *this;
     }
 
     void reset() {
@@ -134,30 +435,52 @@ public:
                 board[i][j] = EMPTY;
             }
         }
-        board[3][4] = board[4][3] = BLACK;
-        board[3][3] = board[4][4] = WHITE;
+        const int c = SIZE / 2;
+        board[c-1][c] = board[c][c-1] = BLACK;
+        board[c-1][c-1] = board[c][c] = WHITE;
         cur_player = BLACK;
-        disc_count[EMPTY] = 8*8-4;
-        disc_count[BLACK] = 2;
-        disc_count[WHITE] = 2;
+        sync();
         next_valid_spots = get_valid_spots();
         done = false;
         winner = -1;
     }
-    std::vector<Point> get_valid_spots() const {
-        std::vector<Point> valid_spots;
+    // Recount discs and rebuild the bitboards and accumulators after the board was written directly.
+    void sync() {
+        disc_count = {0, 0, 0};
+        bits[EMPTY] = bits[BLACK] = bits[WHITE] = 0;
         for (int i = 0; i < SIZE; i++) {
             for (int j = 0; j < SIZE; j++) {
-                Point p = Point(i, j);
-                if (board[i][j] != EMPTY)
-                    continue;
-                if (is_spot_valid(p))
-                    valid_spots.push_back(p);
+                disc_count[board[i][j]]++;
+                bits[board[i][j]] |= BB::bit(i * SIZE + j);
             }
         }
+        refresh_accumulator();
+    }
+    void refresh_accumulator() {
+        if (N != 8 || !nnue.loaded) return;
+        std::copy(nnue.bias, nnue.bias + NN_HIDDEN, accumulator[0]);
+        std::copy(nnue.bias, nnue.bias + NN_HIDDEN, accumulator[1]);
+        for (int i = 0; i < SIZE; i++) {
+            for (int j = 0; j < SIZE; j++) {
+                int disc = board[i][j], sq = i * SIZE + j;
+                if (disc == EMPTY) continue;
+                nnue.acc_add(accumulator[0], nnue.weight[(disc == BLACK ? 0 : 64) + sq]);
+                nnue.acc_add(accumulator[1], nnue.weight[(disc == WHITE ? 0 : 64) + sq]);
+            }
+        }
+    }
+    std::vector<Point> get_valid_spots() const {
+        PROFILE_SCOPE("get_valid_spots");
+        std::vector<Point> valid_spots;
+        // Lowest square first, the same row-major order as scanning the board.
+        for (Bits moves = legal_moves(); moves; moves &= moves - 1) {
+            int sq = BB::lowest(moves);
+            valid_spots.push_back(Point(sq / SIZE, sq % SIZE));
+        }
         return valid_spots;
     }
     bool put_disc(Point p) {
+        PROFILE_SCOPE("put_disc");
         if(!is_spot_valid(p)) {
             winner = get_next_player(cur_player);
             done = true;
@@ -189,39 +512,128 @@ public:
     
     
 };
+typedef BasicOthelloBoard<8> OthelloBoard;
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-int player;
-const int SIZE = 8;
-std::vector<Point> next_valid_spots;
-OthelloBoard global;
-
-const int boardWeight[8][8] = { 
-    {25, -5,  11,  6,  6, 11, -5, 25},
-    {-5, -10,   1,  1,  1,  1, -10, -5},
-    { 11,  1,   4,  2,  2,  4,   1, 11},
-    {  6,  1,   2,  1,  1,  2,   1,  6},
-    {  6,  1,   2,  1,  1,  2,   1,  6},
-    { 11,  1,   4,  2,  2,  4,   1, 11},
-    {-5, -10,   1,  1,  1,  1, -10, -5},
-    {25, -5,  11,  6,  6, 11, -5, 25 }
-}; 
+thread_local int player; // point of view of the evaluation (set per thread by the tools)
+const int SIZE = 8;           // the main game; tools and game records are 8x8
+
+// Evaluation weights used by corner(). The defaults are the hand-picked values; `tuner` fits new ones
+// and writes them to WEIGHTS_FILE (or $ALPHAOTHELLO_WEIGHTS), which is loaded at startup.
+struct EvalParams {
+    int boardWeight[8][8] = {
+        {25, -5,  11,  6,  6, 11, -5, 25},
+        {-5, -10,   1,  1,  1,  1, -10, -5},
+        { 11,  1,   4,  2,  2,  4,   1, 11},
+        {  6,  1,   2,  1,  1,  2,   1,  6},
+        {  6,  1,   2,  1,  1,  2,   1,  6},
+        { 11,  1,   4,  2,  2,  4,   1, 11},
+        {-5, -10,   1,  1,  1,  1, -10, -5},
+        {25, -5,  11,  6,  6, 11, -5, 25 }
+    };
+    int mobility = 1;       // per valid spot when it is our turn
+    int win = 110;
+    int corner = 50;
+    int edge_run = 1;       // per disc in the run along the edge from an owned corner
+    int c_square = 2;       // per disc next to an owned corner
+    int x_square = 3;       // diagonal square of an owned corner
+    int phase_mult[4] = {20, 5, 25, 30}; // opening without corners, behind on corners, midgame, endgame
+    int phase_empties[2] = {48, 24};
+} eval_params;
+
+// Weights of the engine being searched. Tools that play different parameter sets against each other
+// point it at the set of the side to move (per thread, like `player`).
+thread_local const EvalParams* active_params = &eval_params;
+
+// Search and time management knobs, also read from WEIGHTS_FILE. `spsa` tunes them in games.
+struct SearchParams {
+    int depth = DEPTH;                     // fixed depth without deadlines, short search before the endgame solver
+    int endgame_empties = ENDGAME_EMPTIES; // try to solve exactly from this many empties, on any board size
+    int time_reserve = 10;                 // percent of the bank kept back, at most 500ms
+    int time_moves = 50;                   // moves still to play, percent of the empties
+    int time_increment = 75;               // percent of the increment spent on top of the share of the bank
+} search_params;
+
+// Text format: one "name value..." line per field, fields may be left out.
+// Nothing is changed unless the whole file reads correctly.
+bool load_params(const char* filename, EvalParams& loaded_params, SearchParams& loaded_search = search_params) {
+    std::ifstream fin(filename);
+    if (!fin) return false;
+    EvalParams params = loaded_params;
+    SearchParams search = loaded_search;
+    std::string name;
+    while (fin >> name) {
+        int* values;
+        int n = 1;
+        if (name == "boardWeight") values = &params.boardWeight[0][0], n = 64;
+        else if (name == "mobility") values = &params.mobility;
+        else if (name == "win") values = &params.win;
+        else if (name == "corner") values = &params.corner;
+        else if (name == "edge_run") values = &params.edge_run;
+        else if (name == "c_square") values = &params.c_square;
+        else if (name == "x_square") values = &params.x_square;
+        else if (name == "phase_mult") values = params.phase_mult, n = 4;
+        else if (name == "phase_empties") values = params.phase_empties, n = 2;
+        else if (name == "depth") values = &search.depth;
+        else if (name == "endgame_empties") values = &search.endgame_empties;
+        else if (name == "time_reserve") values = &search.time_reserve;
+        else if (name == "time_moves") values = &search.time_moves;
+        else if (name == "time_increment") values = &search.time_increment;
+        else return false;
+        for (int i = 0; i < n; i++)
+            if (!(fin >> values[i])) return false;
+    }
+    loaded_params = params;
+    loaded_search = search;
+    return true;
+}
+
+void write_params(std::ostream& out, const EvalParams& params, const SearchParams& search = search_params) {
+    out << "boardWeight\n";
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 8; j++)
+            out << " " << params.boardWeight[i][j];
+        out << "\n";
+    }
+    out << "mobility " << params.mobility << "\n";
+    out << "win " << params.win << "\n";
+    out << "corner " << params.corner << "\n";
+    out << "edge_run " << params.edge_run << "\n";
+    out << "c_square " << params.c_square << "\n";
+    out << "x_square " << params.x_square << "\n";
+    out << "phase_mult";
+    for (int m : params.phase_mult) out << " " << m;
+    out << "\nphase_empties " << params.phase_empties[0] << " " << params.phase_empties[1] << "\n";
+    out << "depth " << search.depth << "\n";
+    out << "endgame_empties " << search.endgame_empties << "\n";
+    out << "time_reserve " << search.time_reserve << "\n";
+    out << "time_moves " << search.time_moves << "\n";
+    out << "time_increment " << search.time_increment << "\n";
+}
+
+// Row / column of the 8x8 boardWeight table used for square i of an N x N board:
+// the 4 rows nearest to each edge keep their weights, the middle ones share the centre weights.
+constexpr int weight_index(int n, int i) {
+    return i < n / 2 ? std::min(i, 3) : 7 - std::min(n - 1 - i, 3);
+}
 
 //calculate corner and edges 
-int corner(OthelloBoard now){
+template<int N>
+int corner(const BasicOthelloBoard<N>& now){
+    PROFILE_SCOPE("corner");
 
     int points = 0;
-    if (now.cur_player == player) points += now.next_valid_spots.size();
-    if (now.winner == player) points += 110;
-    if (now.winner == 3 - player) points -= 110;
+    if (now.cur_player == player) points += (int)now.next_valid_spots.size() * active_params->mobility;
+    if (now.winner == player) points += active_params->win;
+    if (now.winner == 3 - player) points -= active_params->win;
 
     int weight = 0;
-    for (int i = 0; i < 8; i++){
-        for (int j = 0; j < 8; j++) {
+    for (int i = 0; i < N; i++){
+        for (int j = 0; j < N; j++) {
             if (now.board[i][j] == player)
-                weight += boardWeight[i][j];
+                weight += active_params->boardWeight[weight_index(N, i)][weight_index(N, j)];
             else if (now.board[i][j] == 3 - player)
-                weight -= boardWeight[i][j];
+                weight -= active_params->boardWeight[weight_index(N, i)][weight_index(N, j)];
         }
     }
 
@@ -232,13 +644,13 @@ int corner(OthelloBoard now){
 
     if(now.board[0][0]==player){
         corner+=1;
-        points += 50;
+        points += active_params->corner;
 
         bool row = false;
         bool col = true;
         int count = 0;
 
-        for(int i=1; i<=6; i++){ 
+        for(int i=1; i<=N-2; i++){ 
             if(now.board[0][i]!=player) row = true;
             if(now.board[i][0]!=player) col = true;
             if(!row && now.board[0][i]==player){
@@ -250,22 +662,22 @@ int corner(OthelloBoard now){
         }
         if(!row && !col) count*=4;
         if(!row || !col) count*=2;
-        points+=count;
+        points+=count*active_params->edge_run;
 
-        if(now.board[0][1] == player) points+=2;
-        if(now.board[1][1] == player) points+=3;
-        if(now.board[1][0] == player) points+=2;
+        if(now.board[0][1] == player) points+=active_params->c_square;
+        if(now.board[1][1] == player) points+=active_params->x_square;
+        if(now.board[1][0] == player) points+=active_params->c_square;
         
     }
     else if(now.board[0][0]==3-player){
-        points -= 50;
+        points -= active_params->corner;
         opcor += 1;
 
         bool row = false;
         bool col = true;
         int count = 0;
 
-        for(int i=1; i<=6; i++){ 
+        for(int i=1; i<=N-2; i++){ 
             if(now.board[0][i]!=3-player) row = true;
             if(now.board[i][0]!=3-player) col = true;
             if(!row && now.board[0][i]==3-player){
@@ -277,178 +689,721 @@ int corner(OthelloBoard now){
         }
         if(!row && !col) count*=4;
         if(!row || !col) count*=2;
-        points-=count;
+        points-=count*active_params->edge_run;
 
-        if(now.board[0][1] == 3-player) points-=2;
-        if(now.board[1][1] == 3-player) points-=3;
-        if(now.board[1][0] == 3-player) points-=2;
+        if(now.board[0][1] == 3-player) points-=active_params->c_square;
+        if(now.board[1][1] == 3-player) points-=active_params->x_square;
+        if(now.board[1][0] == 3-player) points-=active_params->c_square;
     }
 
-    if(now.board[0][7]==player){
+    if(now.board[0][N-1]==player){
         corner+=1;
-        points += 50;
+        points += active_params->corner;
 
         bool row = false;
         bool col = true;
         int count = 0;
-        int i=6;
+        int i=N-2;
         int j=1;
-        while(i!=0 && j!=7){
+        while(i!=0 && j!=N-1){
             if(now.board[0][i]!=player) row = true;
-            if(now.board[j][7]!=player) col = true;
+            if(now.board[j][N-1]!=player) col = true;
             if(now.board[0][i]==player && !row) count+=1;
-            if(now.board[j][7]==player && !col) count +=1;
+            if(now.board[j][N-1]==player && !col) count +=1;
             i--, j++;
         }
         if(!row && !col) count*=4;
         if(!row || !col) count*=2;
-        points+=count;
+        points+=count*active_params->edge_run;
         
-        if(now.board[1][7] == player) points+=2;
-        if(now.board[1][6] == player) points+=3;
-        if(now.board[0][6] == player) points+=2;
+        if(now.board[1][N-1] == player) points+=active_params->c_square;
+        if(now.board[1][N-2] == player) points+=active_params->x_square;
+        if(now.board[0][N-2] == player) points+=active_params->c_square;
     }
-    else if(now.board[0][7]==3-player){
-        points -= 50;
+    else if(now.board[0][N-1]==3-player){
+        points -= active_params->corner;
         opcor += 1;
 
         bool row = false;
         bool col = true;
         int count = 0;
-        int i=6;
+        int i=N-2;
         int j=1;
-        while(i!=0 && j!=7){
+        while(i!=0 && j!=N-1){
             if(now.board[0][i]!=3-player) row = true;
-            if(now.board[j][7]!=3-player) col = true;
+            if(now.board[j][N-1]!=3-player) col = true;
             if(now.board[0][i]==3-player && !row) count+=1;
-            if(now.board[j][7]==3-player && !col) count +=1;
+            if(now.board[j][N-1]==3-player && !col) count +=1;
             i--, j++;
         }
         if(!row && !col) count*=4;
         if(!row || !col) count*=2;
-        points-=count;
+        points-=count*active_params->edge_run;
         
-        if(now.board[1][7] == 3-player) points-=2;
-        if(now.board[1][6] == 3-player) points-=3;
-        if(now.board[0][6] == 3-player) points-=2;
+        if(now.board[1][N-1] == 3-player) points-=active_params->c_square;
+        if(now.board[1][N-2] == 3-player) points-=active_params->x_square;
+        if(now.board[0][N-2] == 3-player) points-=active_params->c_square;
     }
 
-    if(now.board[7][0]==player){
+    if(now.board[N-1][0]==player){
         corner+=1;
-        points += 50;
+        points += active_params->corner;
 
         bool row = false;
         bool col = true;
         int count = 0;
-        int j=6;
+        int j=N-2;
         int i=1;
-        while(j!=0 && i!=7){
-            if(now.board[7][i]!=player) row = true;
+        while(j!=0 && i!=N-1){
+            if(now.board[N-1][i]!=player) row = true;
             if(now.board[j][0]!=player) col = true;
-            if(now.board[7][i]==player && !row) count+=1;
+            if(now.board[N-1][i]==player && !row) count+=1;
             if(now.board[j][0]==player && !col) count +=1;
             j--, i++;
         }
         if(!row && !col) count*=4;
         if(!row || !col) count*=2;
-        points+=count;
+        points+=count*active_params->edge_run;
 
-        if(now.board[7][1] == player) points+=2;
-        if(now.board[6][1] == player) points+=3;
-        if(now.board[6][0] == player) points+=2;
+        if(now.board[N-1][1] == player) points+=active_params->c_square;
+        if(now.board[N-2][1] == player) points+=active_params->x_square;
+        if(now.board[N-2][0] == player) points+=active_params->c_square;
     }
-    else if(now.board[7][0]==3-player){
-        points -= 50;
+    else if(now.board[N-1][0]==3-player){
+        points -= active_params->corner;
         opcor += 1;
 
         bool row = false;
         bool col = true;
 
         int count = 0;
-        int j=6;
+        int j=N-2;
         int i=1;
-        while(j!=0 && i!=7){
-            if(now.board[7][i]!=3-player) row = true;
+        while(j!=0 && i!=N-1){
+            if(now.board[N-1][i]!=3-player) row = true;
             if(now.board[j][0]!=3-player) col = true;
-            if(now.board[7][i]==3-player && !row) count+=1;
+            if(now.board[N-1][i]==3-player && !row) count+=1;
             if(now.board[j][0]==3-player && !col) count +=1;
             j--, i++;
         }
         if(!row && !col) count*=4;
         if(!row || !col) count*=2;
-        points-=count;
+        points-=count*active_params->edge_run;
 
-        if(now.board[7][1] == 3-player) points-=2;
-        if(now.board[6][1] == 3-player) points-=3;
-        if(now.board[6][0] == 3-player) points-=2;
+        if(now.board[N-1][1] == 3-player) points-=active_params->c_square;
+        if(now.board[N-2][1] == 3-player) points-=active_params->x_square;
+        if(now.board[N-2][0] == 3-player) points-=active_params->c_square;
     }
 
-    if(now.board[7][7]==player){
+    if(now.board[N-1][N-1]==player){
         corner+=1;
-        points += 50;
+        points += active_params->corner;
 
         bool row = false;
         bool col = true;
         int count = 0;
-        for(int i=6; i>=1; i--){ 
-            if(now.board[7][i]!=player) row = true;
-            if(now.board[i][7]!=player) col = true;
-            if(!row && now.board[7][i]==player){
+        for(int i=N-2; i>=1; i--){ 
+            if(now.board[N-1][i]!=player) row = true;
+            if(now.board[i][N-1]!=player) col = true;
+            if(!row && now.board[N-1][i]==player){
                 count+=1;
             }
-            if(!col && now.board[i][7]==player){
+            if(!col && now.board[i][N-1]==player){
                 count+=1;
             }
         }
         if(!row && !col) count*=4;
         if(!row || !col) count*=2;
-        points+=count;
+        points+=count*active_params->edge_run;
 
-        if(now.board[6][7] == player) points+=2;
-        if(now.board[6][6] == player) points+=3;
-        if(now.board[7][6] == player) points+=2;
+        if(now.board[N-2][N-1] == player) points+=active_params->c_square;
+        if(now.board[N-2][N-2] == player) points+=active_params->x_square;
+        if(now.board[N-1][N-2] == player) points+=active_params->c_square;
     }
-    else if(now.board[7][7]==3-player){
-        points -= 50;
+    else if(now.board[N-1][N-1]==3-player){
+        points -= active_params->corner;
         opcor += 1;
 
         bool row = false;
         bool col = true;
         int count = 0;
-        for(int i=6; i>=1; i--){ 
-            if(now.board[7][i]!=3-player) row = true;
-            if(now.board[i][7]!=3-player) col = true;
-            if(!row && now.board[7][i]==3-player){
+        for(int i=N-2; i>=1; i--){ 
+            if(now.board[N-1][i]!=3-player) row = true;
+            if(now.board[i][N-1]!=3-player) col = true;
+            if(!row && now.board[N-1][i]==3-player){
                 count+=1;
             }
-            if(!col && now.board[i][7]==3-player){
+            if(!col && now.board[i][N-1]==3-player){
                 count+=1;
             }
         }
         if(!row && !col) count*=4;
         if(!row || !col) count*=2;
-        points-=count;
+        points-=count*active_params->edge_run;
         
-        if(now.board[6][7] == 3-player) points-=2;
-        if(now.board[6][6] == 3-player) points-=3;
-        if(now.board[7][6] == 3-player) points-=2;
+        if(now.board[N-2][N-1] == 3-player) points-=active_params->c_square;
+        if(now.board[N-2][N-2] == 3-player) points-=active_params->x_square;
+        if(now.board[N-1][N-2] == 3-player) points-=active_params->c_square;
     }
 
     // std::cout<<now.cur_player<<"-crnr:"<<points*1<<' ';
 
     size_t disc_diff = now.disc_count[player] - now.disc_count[3-player];
 
-    if(now.disc_count[now.EMPTY] > 48 && corner==0) return disc_diff + points*20;
-    else if(opcor >corner) return disc_diff + points*5;
-    else if(now.disc_count[now.EMPTY] > 24) return disc_diff + points*25;
-    return disc_diff + points*30;
+    // phase_empties are for the 60 empties of 8x8, scale them to the board
+    int empties = now.disc_count[now.EMPTY] * 60 / (N * N - 4);
+    if(empties > active_params->phase_empties[0] && corner==0) return disc_diff + points*active_params->phase_mult[0];
+    else if(opcor >corner) return disc_diff + points*active_params->phase_mult[1];
+    else if(empties > active_params->phase_empties[1]) return disc_diff + points*active_params->phase_mult[2];
+    return disc_diff + points*active_params->phase_mult[3];
 }
 
 
-int heuristic(OthelloBoard now){
+// Network score from the point of view of `player`.
+template<int N>
+int nnue_evaluate(const BasicOthelloBoard<N>& now) {
+    PROFILE_SCOPE("nnue_evaluate");
+    const int16_t* us = now.accumulator[now.cur_player - 1];
+    const int16_t* them = now.accumulator[2 - now.cur_player];
+    int score = (nnue.propagate(us, them, nnue.out) + nnue.out_bias) >> nnue.out_shift;
+    return now.cur_player == player ? score : -score;
+}
+
+// A finished game on the network's scale: past any evaluation, ordered by the disc difference.
+template<int N>
+int nnue_final_score(const BasicOthelloBoard<N>& now) {
+    int diff = now.disc_count[player] - now.disc_count[3 - player];
+    return diff == 0 ? 0 : diff + (diff > 0 ? nnue.bound : -nnue.bound);
+}
+
+template<int N>
+int heuristic(const BasicOthelloBoard<N>& now){
+    if (N == 8 && nnue.loaded) return now.done ? nnue_final_score(now) : nnue_evaluate(now);
     return corner(now);
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Batched evaluation for offline jobs (analysis, tuning, self-play statistics).
+// Positions are stored structure-of-arrays, square-major: cells[sq * capacity + i] is square sq of
+// position i, so one load gives the same square of 8 positions. evaluate_batch() returns exactly what
+// corner() returns for each position (NNUE is not used here), 8 positions per step with AVX2.
+template<int N>
+struct EvalBatch {
+    int capacity;
+    int count = 0;
+    std::vector<int8_t> cells;      // [N * N][capacity]
+    std::vector<int32_t> me;        // point of view (`player` for corner())
+    std::vector<int32_t> to_move;
+    std::vector<int32_t> mobility;  // next_valid_spots.size()
+    std::vector<int32_t> winner;
+    // capacity is rounded up to a multiple of 8 lanes; unused lanes are empty boards
+    explicit EvalBatch(int capacity) : capacity((capacity + 7) / 8 * 8), cells(N * N * this->capacity, 0),
+        me(this->capacity, 1), to_move(this->capacity, 1), mobility(this->capacity, 0), winner(this->capacity, -1) {}
+    bool add(const BasicOthelloBoard<N>& board, int pov) {
+        if (count == capacity) return false;
+        for (int i = 0; i < N; i++)
+            for (int j = 0; j < N; j++)
+                cells[(i * N + j) * capacity + count] = board.board[i][j];
+        me[count] = pov;
+        to_move[count] = board.cur_player;
+        mobility[count] = board.next_valid_spots.size();
+        winner[count] = board.winner;
+        count++;
+        return true;
+    }
+    void clear() {
+        count = 0;
+    }
+};
+
+// Squares corner() looks at around each corner: the corner, the run along its edge row,
+// the two adjacent squares and the diagonal one.
+template<int N>
+struct CornerSquares {
+    int corner, run[N - 2], c1, x, c2;
+};
+template<int N>
+void corner_squares(CornerSquares<N> corners[4]) {
+    const int rows[4] = {0, 0, N - 1, N - 1}, cols[4] = {0, N - 1, 0, N - 1};
+    for (int k = 0; k < 4; k++) {
+        int r = rows[k], c = cols[k], dr = r == 0 ? 1 : -1, dc = c == 0 ? 1 : -1;
+        corners[k].corner = r * N + c;
+        for (int i = 0; i < N - 2; i++)
+            corners[k].run[i] = r * N + c + dc * (i + 1);
+        corners[k].c1 = (r + dr) * N + c;
+        corners[k].x = (r + dr) * N + c + dc;
+        corners[k].c2 = r * N + c + dc;
+    }
+}
+
+template<int N>
+void evaluate_batch_scalar(const EvalBatch<N>& batch, const int* weight, int* out) {
+    CornerSquares<N> corners[4];
+    corner_squares<N>(corners);
+    const int cap = batch.capacity;
+    for (int i = 0; i < batch.count; i++) {
+        int me = batch.me[i], op = 3 - me;
+        auto cell = [&](int sq) { return (int)batch.cells[sq * cap + i]; };
+        int points = 0;
+        if (batch.to_move[i] == me) points += batch.mobility[i] * active_params->mobility;
+        if (batch.winner[i] == me) points += active_params->win;
+        if (batch.winner[i] == op) points -= active_params->win;
+        int w = 0, discs = 0, empties = 0;
+        for (int sq = 0; sq < N * N; sq++) {
+            if (cell(sq) == me) w += weight[sq], discs++;
+            else if (cell(sq) == op) w -= weight[sq], discs--;
+            else empties++;
+        }
+        points += w*0.1;
+        int owned[3] = {0, 0, 0};
+        for (int k = 0; k < 4; k++) {
+            int owner = cell(corners[k].corner);
+            if (owner != me && owner != op) continue;
+            int sign = owner == me ? 1 : -1;
+            owned[owner]++;
+            int run = 0;
+            while (run < N - 2 && cell(corners[k].run[run]) == owner) run++;
+            int count = run == N - 2 ? run * 2 : run;
+            points += sign * (active_params->corner + count * active_params->edge_run);
+            points += sign * ((cell(corners[k].c1) == owner) * active_params->c_square
+                            + (cell(corners[k].x) == owner) * active_params->x_square
+                            + (cell(corners[k].c2) == owner) * active_params->c_square);
+        }
+        int scaled = empties * 60 / (N * N - 4);
+        int mult;
+        if (scaled > active_params->phase_empties[0] && owned[me] == 0) mult = active_params->phase_mult[0];
+        else if (owned[op] > owned[me]) mult = active_params->phase_mult[1];
+        else if (scaled > active_params->phase_empties[1]) mult = active_params->phase_mult[2];
+        else mult = active_params->phase_mult[3];
+        out[i] = (int)((unsigned)discs + (unsigned)points * (unsigned)mult);
+    }
+}
+
+#ifdef NNUE_X86
+// Square sq of 8 consecutive positions, widened to 32-bit lanes.
+__attribute__((target("avx2")))
+static inline __m256i load_cells(const int8_t* cells) {
+    return _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)cells));
+}
+
+template<int N>
+__attribute__((target("avx2")))
+void evaluate_batch_avx2(const EvalBatch<N>& batch, const int* weight, int* out) {
+    CornerSquares<N> corners[4];
+    corner_squares<N>(corners);
+    const int cap = batch.capacity;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i three = _mm256_set1_epi32(3);
+    const __m256d tenth = _mm256_set1_pd(0.1);
+    for (int i = 0; i < batch.count; i += 8) {
+        const int8_t* cells = &batch.cells[i];
+        __m256i me = _mm256_loadu_si256((const __m256i*)&batch.me[i]);
+        __m256i op = _mm256_sub_epi32(three, me);
+        __m256i to_move = _mm256_loadu_si256((const __m256i*)&batch.to_move[i]);
+        __m256i winner = _mm256_loadu_si256((const __m256i*)&batch.winner[i]);
+        __m256i mobility = _mm256_loadu_si256((const __m256i*)&batch.mobility[i]);
+
+        __m256i points = _mm256_and_si256(_mm256_cmpeq_epi32(to_move, me),
+                                          _mm256_mullo_epi32(mobility, _mm256_set1_epi32(active_params->mobility)));
+        __m256i win = _mm256_set1_epi32(active_params->win);
+        points = _mm256_add_epi32(points, _mm256_and_si256(_mm256_cmpeq_epi32(winner, me), win));
+        points = _mm256_sub_epi32(points, _mm256_and_si256(_mm256_cmpeq_epi32(winner, op), win));
+
+        __m256i w = zero, discs = zero, empties = zero;
+        for (int sq = 0; sq < N * N; sq++) {
+            __m256i c = load_cells(cells + sq * cap), ws = _mm256_set1_epi32(weight[sq]);
+            __m256i own = _mm256_cmpeq_epi32(c, me), opp = _mm256_cmpeq_epi32(c, op);
+            w = _mm256_add_epi32(w, _mm256_sub_epi32(_mm256_and_si256(own, ws), _mm256_and_si256(opp, ws)));
+            discs = _mm256_add_epi32(discs, _mm256_sub_epi32(opp, own));  // masks are -1
+            empties = _mm256_sub_epi32(empties, _mm256_cmpeq_epi32(c, zero));
+        }
+        // points += w*0.1, in double like the scalar code
+        __m256d lo = _mm256_add_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(points)),
+                                   _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(w)), tenth));
+        __m256d hi = _mm256_add_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(points, 1)),
+                                   _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(w, 1)), tenth));
+        points = _mm256_set_m128i(_mm256_cvttpd_epi32(hi), _mm256_cvttpd_epi32(lo));
+
+        __m256i owned_me = zero, owned_op = zero;
+        for (int k = 0; k < 4; k++) {
+            __m256i owner = load_cells(cells + corners[k].corner * cap);
+            __m256i is_me = _mm256_cmpeq_epi32(owner, me), is_op = _mm256_cmpeq_epi32(owner, op);
+            owned_me = _mm256_sub_epi32(owned_me, is_me);
+            owned_op = _mm256_sub_epi32(owned_op, is_op);
+            __m256i alive = _mm256_or_si256(is_me, is_op), run = zero;
+            for (int r = 0; r < N - 2; r++) {
+                alive = _mm256_and_si256(alive, _mm256_cmpeq_epi32(load_cells(cells + corners[k].run[r] * cap), owner));
+                run = _mm256_sub_epi32(run, alive);
+            }
+            __m256i full = _mm256_cmpeq_epi32(run, _mm256_set1_epi32(N - 2));
+            __m256i count = _mm256_add_epi32(run, _mm256_and_si256(full, run));
+            __m256i bonus = _mm256_add_epi32(_mm256_set1_epi32(active_params->corner),
+                                             _mm256_mullo_epi32(count, _mm256_set1_epi32(active_params->edge_run)));
+            __m256i c1 = _mm256_cmpeq_epi32(load_cells(cells + corners[k].c1 * cap), owner);
+            __m256i x = _mm256_cmpeq_epi32(load_cells(cells + corners[k].x * cap), owner);
+            __m256i c2 = _mm256_cmpeq_epi32(load_cells(cells + corners[k].c2 * cap), owner);
+            bonus = _mm256_add_epi32(bonus, _mm256_and_si256(c1, _mm256_set1_epi32(active_params->c_square)));
+            bonus = _mm256_add_epi32(bonus, _mm256_and_si256(x, _mm256_set1_epi32(active_params->x_square)));
+            bonus = _mm256_add_epi32(bonus, _mm256_and_si256(c2, _mm256_set1_epi32(active_params->c_square)));
+            points = _mm256_add_epi32(points, _mm256_sub_epi32(_mm256_and_si256(is_me, bonus), _mm256_and_si256(is_op, bonus)));
+        }
+        // empties * 60 / (N*N-4) > t  <=>  empties * 60 >= (t + 1) * (N*N-4)
+        __m256i e60 = _mm256_mullo_epi32(empties, _mm256_set1_epi32(60));
+        __m256i opening = _mm256_cmpgt_epi32(e60, _mm256_set1_epi32((active_params->phase_empties[0] + 1) * (N * N - 4) - 1));
+        __m256i midgame = _mm256_cmpgt_epi32(e60, _mm256_set1_epi32((active_params->phase_empties[1] + 1) * (N * N - 4) - 1));
+        __m256i mult = _mm256_blendv_epi8(_mm256_set1_epi32(active_params->phase_mult[3]), _mm256_set1_epi32(active_params->phase_mult[2]), midgame);
+        mult = _mm256_blendv_epi8(mult, _mm256_set1_epi32(active_params->phase_mult[1]), _mm256_cmpgt_epi32(owned_op, owned_me));
+        mult = _mm256_blendv_epi8(mult, _mm256_set1_epi32(active_params->phase_mult[0]),
+                                  _mm256_and_si256(opening, _mm256_cmpeq_epi32(owned_me, zero)));
+        __m256i score = _mm256_add_epi32(discs, _mm256_mullo_epi32(points, mult));
+        if (i + 8 <= batch.count) {
+            _mm256_storeu_si256((__m256i*)&out[i], score);
+        } else {
+            alignas(32) int tail[8];
+            _mm256_store_si256((__m256i*)tail, score);
+            std::copy(tail, tail + batch.count - i, out + i);
+        }
+    }
+}
+#endif
+
+// out[i] = corner() of position i, seen from batch.me[i].
+template<int N>
+void evaluate_batch(const EvalBatch<N>& batch, int* out) {
+    int weight[N * N];
+    for (int i = 0; i < N; i++)
+        for (int j = 0; j < N; j++)
+            weight[i * N + j] = active_params->boardWeight[weight_index(N, i)][weight_index(N, j)];
+#ifdef NNUE_X86
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if (avx2) {
+        evaluate_batch_avx2(batch, weight, out);
+        return;
+    }
+#endif
+    evaluate_batch_scalar(batch, weight, out);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Transposition / solved-position table.
+// Buckets of 4 entries of 16 bytes. An entry stores (key ^ data, data) with relaxed atomic accesses,
+// so torn writes from concurrent threads or processes are detected on probe instead of needing locks.
+// The table lives on the heap, or in a file mapped with MAP_SHARED when $ALPHAOTHELLO_CACHE is set:
+// then it survives between the launches of player_new, so the next move starts with the previous
+// search (two plies shallower) already in the table.
+enum TT_BOUND { TT_NONE = 0, TT_EXACT = 1, TT_LOWER = 2, TT_UPPER = 3 };
+
+struct TTEntry {
+    int score;
+    int depth;
+    int bound;
+    Point move;
+};
+
+struct TTHeader {
+    char magic[8];          // "AOCACHE1"
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t buckets;
+    uint64_t signature;     // evaluation the scores were computed with
+    char reserved[32];
+};
+const uint32_t TT_VERSION = 2;
+
+inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+inline uint64_t hash_bits(uint64_t b) {
+    return mix64(b);
+}
+inline uint64_t hash_bits(unsigned __int128 b) {
+    return mix64((uint64_t)b ^ mix64((uint64_t)(b >> 64)));
+}
+
+class TranspositionTable {
+public:
+    ~TranspositionTable() {
+        close();
+    }
+    bool enabled() const {
+        return table != nullptr;
+    }
+    // Backed by a file, other processes mapping it see the same entries.
+    bool shared() const {
+        return mapping != nullptr;
+    }
+    void allocate(size_t mb) {
+        close();
+        buckets = bucket_count(mb);
+        heap.assign(buckets * 8, 0);
+        table = heap.data();
+    }
+    // Maps `filename`, creating or resetting it when the header does not match.
+    bool open(const char* filename, size_t mb, uint64_t signature) {
+#ifndef _WIN32
+        close();
+        int fd = ::open(filename, O_RDWR | O_CREAT, 0644);
+        if (fd < 0) return false;
+        buckets = bucket_count(mb);
+        size_t bytes = sizeof(TTHeader) + buckets * 64;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || ((size_t)st.st_size != bytes && ftruncate(fd, bytes) != 0)) {
+            ::close(fd);
+            return false;
+        }
+        void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return false;
+        mapping = p;
+        mapping_size = bytes;
+        TTHeader* header = (TTHeader*)p;
+        table = (uint64_t*)((char*)p + sizeof(TTHeader));
+        if (memcmp(header->magic, "AOCACHE1", 8) != 0 || header->version != TT_VERSION
+            || header->header_size != sizeof(TTHeader) || header->buckets != buckets || header->signature != signature) {
+            memset(p, 0, bytes);
+            memcpy(header->magic, "AOCACHE1", 8);
+            header->version = TT_VERSION;
+            header->header_size = sizeof(TTHeader);
+            header->buckets = buckets;
+            header->signature = signature;
+        }
+        return true;
+#else
+        (void)filename; (void)mb; (void)signature;
+        return false;
+#endif
+    }
+    void close() {
+#ifndef _WIN32
+        if (mapping) {
+            msync(mapping, mapping_size, MS_ASYNC);
+            munmap(mapping, mapping_size);
+        }
+#endif
+        mapping = nullptr;
+        heap.clear();
+        table = nullptr;
+    }
+    bool probe(uint64_t key, TTEntry& entry) const {
+        uint64_t* bucket = table + (key & (buckets - 1)) * 8;
+        for (int i = 0; i < 4; i++) {
+            uint64_t k = __atomic_load_n(&bucket[2 * i], __ATOMIC_RELAXED);
+            uint64_t d = __atomic_load_n(&bucket[2 * i + 1], __ATOMIC_RELAXED);
+            if ((k ^ d) != key || d == 0) continue;
+            unpack(d, entry);
+            return true;
+        }
+        return false;
+    }
+    // Replaces the same position, else the shallowest entry of the bucket.
+    void store(uint64_t key, int depth, int bound, int score, Point move) {
+        uint64_t* bucket = table + (key & (buckets - 1)) * 8;
+        int victim = 0, victim_depth = INT_MAX;
+        for (int i = 0; i < 4; i++) {
+            uint64_t k = __atomic_load_n(&bucket[2 * i], __ATOMIC_RELAXED);
+            uint64_t d = __atomic_load_n(&bucket[2 * i + 1], __ATOMIC_RELAXED);
+            if ((k ^ d) == key) {
+                if ((int)((d >> 32) & 0xff) > depth) return; // keep the deeper result
+                victim = i;
+                break;
+            }
+            int entry_depth = d == 0 ? -1 : (int)((d >> 32) & 0xff);
+            if (entry_depth < victim_depth) victim = i, victim_depth = entry_depth;
+        }
+        uint64_t d = (uint32_t)score | (uint64_t)(depth & 0xff) << 32 | (uint64_t)bound << 40
+                   | (uint64_t)(move.x < 0 ? 0xff : move.x * 16 + move.y) << 48;
+        __atomic_store_n(&bucket[2 * victim], key ^ d, __ATOMIC_RELAXED);
+        __atomic_store_n(&bucket[2 * victim + 1], d, __ATOMIC_RELAXED);
+    }
+private:
+    static size_t bucket_count(size_t mb) {
+        size_t n = 1;
+        while (n * 2 * 64 <= std::max<size_t>(mb, 1) << 20) n *= 2;
+        return n;
+    }
+    static void unpack(uint64_t d, TTEntry& entry) {
+        entry.score = (int)(uint32_t)d;
+        entry.depth = (d >> 32) & 0xff;
+        entry.bound = (d >> 40) & 0x3;
+        int move = (d >> 48) & 0xff;
+        entry.move = move == 0xff ? Point(-1, -1) : Point(move / 16, move % 16);
+    }
+    uint64_t* table = nullptr;
+    size_t buckets = 0;
+    std::vector<uint64_t> heap;
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+} tt;
+
+// Key of a search node: the position, who is to move and whose point of view the scores are in.
+template<int N>
+uint64_t position_key(const BasicOthelloBoard<N>& board) {
+    typedef BasicOthelloBoard<N> Board;
+    uint64_t h = hash_bits(board.bits[Board::BLACK]) ^ mix64(hash_bits(board.bits[Board::WHITE]) + N);
+    return mix64(h + board.cur_player * 0x9e3779b97f4a7c15ULL + player * 0xc2b2ae3d27d4eb4fULL);
+}
+
+// Changes whenever the evaluation changes, so a cache file is not reused with different scores.
+uint64_t eval_signature() {
+    uint64_t h = mix64(TT_VERSION);
+    const int* p = (const int*)&eval_params;
+    for (size_t i = 0; i < sizeof(EvalParams) / sizeof(int); i++)
+        h = mix64(h ^ (uint32_t)p[i]);
+    if (nnue.loaded) {
+        const int16_t* w = &nnue.weight[0][0];
+        for (int i = 0; i < NN_INPUTS * NN_HIDDEN; i++)
+            h = mix64(h ^ (uint16_t)w[i]);
+        for (int i = 0; i < NN_HIDDEN; i++)
+            h = mix64(h ^ (uint16_t)nnue.bias[i]);
+        for (int i = 0; i < 2 * NN_HIDDEN; i++)
+            h = mix64(h ^ (uint8_t)nnue.out[i]);
+        h = mix64(h ^ (uint32_t)nnue.out_bias ^ (uint64_t)nnue.out_shift << 32);
+    }
+    return h;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Search trace (ALPHAOTHELLO_TRACE=<file>, not on Windows).
+// Events of the current move go into a preallocated ring. If the move took at least ALPHAOTHELLO_TRACE_MS
+// (default 0: every move) the ring is appended to the file, also from the deadline handler, so dumping
+// only uses write() on a descriptor opened up front. ./traceview prints and summarises the file.
+// Per dump: TraceHeader, size * size cells of the position (0 empty, 1 black, 2 white), then
+// `count` TraceEvents, oldest first. `total - count` older events were overwritten.
+enum TraceType : uint8_t {
+    TRACE_MOVE_START,      // a = empties, b = legal moves
+    TRACE_ITERATION_START, // depth
+    TRACE_ROOT_MOVE,       // depth, move, a = score, b = alpha before it (score <= alpha: upper bound only)
+    TRACE_TT_STATS,        // depth, a = tt hits, b = tt cutoffs during the iteration
+    TRACE_ITERATION_END,   // depth, best move, a = score, b = nodes
+    TRACE_ENDGAME_START,   // a = empties, b = ms this try may take
+    TRACE_ENDGAME_END,     // best move (none: out of time), a = score
+    TRACE_STOP,            // depth of the iteration cut short by the soft deadline
+    TRACE_MOVE_END,        // move played
+    TRACE_DEADLINE,        // move written by the handler, a = signal
+};
+
+struct TraceEvent {
+    uint32_t time_us; // since the move started
+    uint8_t type, depth;
+    uint8_t move;     // x * 16 + y, 0xff for none
+    uint8_t reserved;
+    int32_t a, b;
+};
+
+struct TraceHeader {
+    char magic[8];    // "AOTRACE1"
+    uint32_t count, total;
+    uint32_t elapsed_us;
+    uint8_t size, player;
+    uint16_t reserved;
+};
+
+const int TRACE_EVENTS = 4096;
+
+class Trace {
+public:
+    bool on = false;
+    const void* root = nullptr; // MiniMax reports the children of this board as root moves
+    // Counters of the current iteration.
+    long nodes = 0, tt_hits = 0, tt_cutoffs = 0;
+
+    void open(const char* filename, int slow_ms) {
+#ifndef _WIN32
+        fd = ::open(filename, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        on = fd >= 0;
+        threshold_us = std::max(slow_ms, 0) * 1000u;
+#else
+        (void)filename; (void)slow_ms;
+#endif
+    }
+    template<int N>
+    void begin(const BasicOthelloBoard<N>& board) {
+        if (!on) return;
+        total = 0;
+        memcpy(header.magic, "AOTRACE1", 8);
+        header.size = N;
+        header.player = board.cur_player;
+        header.reserved = 0;
+        for (int i = 0; i < N; i++)
+            for (int j = 0; j < N; j++)
+                cells[i * N + j] = board.board[i][j];
+        root = &board;
+        start = now_us();
+    }
+    void event(uint8_t type, int depth, Point move, int a, int b) {
+        if (!on) return;
+        TraceEvent& e = ring[total++ % TRACE_EVENTS];
+        e.time_us = elapsed_us();
+        e.type = type;
+        e.depth = depth;
+        e.move = move.x < 0 ? 0xff : move.x * 16 + move.y;
+        e.reserved = 0;
+        e.a = a;
+        e.b = b;
+    }
+    uint32_t elapsed_us() const {
+        return now_us() - start;
+    }
+    bool slow() const {
+        return on && elapsed_us() >= threshold_us;
+    }
+    // Async-signal-safe.
+    void dump() {
+#ifndef _WIN32
+        if (!on) return;
+        uint32_t count = std::min<uint32_t>(total, TRACE_EVENTS), first = (total - count) % TRACE_EVENTS;
+        header.count = count;
+        header.total = total;
+        header.elapsed_us = elapsed_us();
+        write_all(&header, sizeof(header));
+        write_all(cells, header.size * header.size);
+        uint32_t tail = std::min<uint32_t>(count, TRACE_EVENTS - first);
+        write_all(ring + first, tail * sizeof(TraceEvent));
+        write_all(ring, (count - tail) * sizeof(TraceEvent));
+#endif
+    }
+
+private:
+    int fd = -1;
+    uint32_t threshold_us = 0;
+    uint32_t start = 0;
+    uint32_t total = 0;
+    TraceHeader header;
+    uint8_t cells[100];
+    TraceEvent ring[TRACE_EVENTS];
+
+    static uint32_t now_us() {
+#ifndef _WIN32
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint32_t)(ts.tv_sec * 1000000ull + ts.tv_nsec / 1000);
+#else
+        return 0;
+#endif
+    }
+    void write_all(const void* data, size_t n) {
+#ifndef _WIN32
+        const char* p = (const char*)data;
+        while (n > 0) {
+            ssize_t written = write(fd, p, n);
+            if (written <= 0) return;
+            p += written;
+            n -= written;
+        }
+#else
+        (void)data; (void)n;
+#endif
+    }
+};
+
+Trace trace;
+
+// Set by a signal handler to make the searches return early. An interrupted search stores nothing
+// in `tt` and its result is meaningless, callers throw it away.
+volatile sig_atomic_t search_stopped = 0;
+
 class PointValue{
     public:
         Point p;
@@ -459,24 +1414,50 @@ class PointValue{
 
 
 
-PointValue MiniMax(const OthelloBoard curState, int depth, int alpha, int beta){
+template<int N>
+PointValue MiniMax(const BasicOthelloBoard<N>& curState, int depth, int alpha, int beta){
+    PROFILE_SCOPE("MiniMax");
     // bool print=false;
     // if(alpha==INT_MIN&&beta==INT_MIN)print=true;
     //std::cout<<"in"<<depth<<"\n";
+    if (search_stopped) return PointValue(Point(-1,-1), 0);
+    if (trace.on) trace.nodes++;
     if(depth == 0 || curState.done){
         return PointValue(Point(-1,-1),heuristic(curState));
         // return PointValue(Point(-1,-1),CEK(curState));
     }
+    const int alpha_orig = alpha, beta_orig = beta;
+    const int n_spots = curState.next_valid_spots.size();
+    uint64_t key = 0;
+    int first = 0; // index of the hash move, searched first
+    if (tt.enabled()) {
+        key = position_key(curState);
+        TTEntry entry;
+        if (tt.probe(key, entry)) {
+            if (trace.on) trace.tt_hits++;
+            if (entry.depth >= depth && (entry.bound == TT_EXACT
+                || (entry.bound == TT_LOWER && entry.score >= beta)
+                || (entry.bound == TT_UPPER && entry.score <= alpha))) {
+                if (trace.on) trace.tt_cutoffs++;
+                return PointValue(entry.move, entry.score);
+            }
+            for (int i = 0; i < n_spots; i++)
+                if (curState.next_valid_spots[i] == entry.move) first = i;
+        }
+    }
+    PointValue result;
     if(curState.cur_player == player){//max
         // std::cout<<"max"<<depth<<' ';
         Point P_Max = Point(-1,-1);
         int Max = INT_MIN;
         
-        for(auto valid_spot : curState.next_valid_spots){
-            OthelloBoard nextState (curState);
+        for(int i = 0; i < n_spots; i++){
+            Point valid_spot = curState.next_valid_spots[i == 0 ? first : i <= first ? i - 1 : i];
+            BasicOthelloBoard<N> nextState (curState);
             nextState.put_disc(valid_spot);
 
             PointValue nextMoveMin = MiniMax(nextState, depth-1, alpha, beta);
+            if (&curState == trace.root) trace.event(TRACE_ROOT_MOVE, depth, valid_spot, nextMoveMin.score, alpha);
             if(nextMoveMin.score > Max){
                 Max = nextMoveMin.score;
                 P_Max = valid_spot;
@@ -491,15 +1472,16 @@ PointValue MiniMax(const OthelloBoard curState, int depth, int alpha, int beta){
         //std::cout<<depth<<"P_Max , Max: "<<P_Max.x<<P_Max.y<<" "<<Max<<"\n";
             
         // if(print)std::cout<<" "<<depth<<"Max "<<Max<<"\n";
-        return PointValue(P_Max, Max);
+        result = PointValue(P_Max, Max);
     }
     else{//min
         // std::cout<<"min"<<depth<<' ';
         Point P_Min = Point(-1,-1);
         int Min = INT_MAX;
 
-        for(auto valid_spot : curState.next_valid_spots){
-            OthelloBoard nextState (curState);
+        for(int i = 0; i < n_spots; i++){
+            Point valid_spot = curState.next_valid_spots[i == 0 ? first : i <= first ? i - 1 : i];
+            BasicOthelloBoard<N> nextState (curState);
             nextState.put_disc(valid_spot);
             
             PointValue nextMoveMax = MiniMax(nextState, depth-1, alpha, beta);
@@ -516,23 +1498,611 @@ PointValue MiniMax(const OthelloBoard curState, int depth, int alpha, int beta){
         }
         //std::cout<<depth<<"Min: "<<P_Min.x<<P_Min.y<<" "<<Min<<"\n";
         // if(print)std::cout<<" "<<depth<<"Min "<<Min<<"\n";
-        return PointValue(P_Min, Min);
-    }  
+        result = PointValue(P_Min, Min);
+    }
+    if (search_stopped) return result;
+    if (tt.enabled()) {
+        int bound = result.score <= alpha_orig ? TT_UPPER : result.score >= beta_orig ? TT_LOWER : TT_EXACT;
+        tt.store(key, depth, bound, result.score, result.p);
+    }
+    return result;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Multi-PV root search: exact scores for the best `k` root moves in one pass.
+// Root moves are searched best first; once k moves have exact scores the others get alpha = the k-th
+// best score, so they only have to prove they are worse and their scores are upper bounds.
+// The root must be `player`'s move. PVs are read back from `tt`, which also orders the moves below.
+struct RootMove {
+    Point move;
+    int score = INT_MIN;
+    bool exact = false;
+    std::vector<Point> pv;
+};
+
+// Follows the hash moves from `board` for at most `depth` plies.
+template<int N>
+std::vector<Point> tt_principal_variation(BasicOthelloBoard<N> board, int depth) {
+    std::vector<Point> pv;
+    TTEntry entry;
+    for (; depth > 0 && !board.done && tt.enabled(); depth--) {
+        if (!tt.probe(position_key(board), entry)) break;
+        const std::vector<Point>& spots = board.next_valid_spots;
+        if (std::find(spots.begin(), spots.end(), entry.move) == spots.end()) break;
+        pv.push_back(entry.move);
+        board.put_disc(entry.move);
+    }
+    return pv;
+}
+
+// `moves` keeps the order between calls: pass an empty vector first, then the same one for each
+// deeper iteration. Afterwards it is sorted best first and the top k have their PV.
+template<int N>
+void MultiPV(const BasicOthelloBoard<N>& root, int depth, int k, std::vector<RootMove>& moves) {
+    auto better = [](const RootMove& a, const RootMove& b) {
+        return a.score != b.score ? a.score > b.score : a.exact > b.exact;
+    };
+    if (moves.empty()) {
+        for (Point p : root.next_valid_spots) {
+            moves.push_back(RootMove());
+            moves.back().move = p;
+        }
+    }
+    std::stable_sort(moves.begin(), moves.end(), better);
+    std::vector<int> best; // exact scores, descending, at most k
+    for (RootMove& m : moves) {
+        int alpha = (int)best.size() < k ? INT_MIN : best[k - 1];
+        BasicOthelloBoard<N> next(root);
+        next.put_disc(m.move);
+        m.score = MiniMax(next, depth - 1, alpha, INT_MAX).score;
+        m.exact = m.score > alpha;
+        m.pv.clear();
+        if (m.exact) {
+            best.insert(std::upper_bound(best.begin(), best.end(), m.score, std::greater<int>()), m.score);
+            if ((int)best.size() > k) best.pop_back();
+        }
+    }
+    std::stable_sort(moves.begin(), moves.end(), better);
+    for (int i = 0; i < std::min(k, (int)moves.size()); i++) {
+        BasicOthelloBoard<N> next(root);
+        next.put_disc(moves[i].move);
+        moves[i].pv = tt_principal_variation(next, depth - 1);
+        moves[i].pv.insert(moves[i].pv.begin(), moves[i].move);
+    }
+    if (tt.enabled() && !moves.empty())
+        tt.store(position_key(root), depth, TT_EXACT, moves[0].score, moves[0].move);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// MiniMax with an explicit stack, so it can stop after a number of nodes and carry on later.
+// One thread can then interleave the searches of many games (see arena.cpp). Move order, bounds and
+// `tt` use are the same as MiniMax, a finished search returns the same move and score.
+template<int N>
+class ResumableSearch {
+public:
+    // `pov` plays the role of `player` in MiniMax; it is set again on every run().
+    void start(const BasicOthelloBoard<N>& root, int depth, int pov) {
+        this->pov = pov;
+        node_count = 0;
+        if (frames.empty()) frames.resize(1);
+        frames[0].board = root;
+        frames[0].depth = depth;
+        frames[0].alpha = INT_MIN;
+        frames[0].beta = INT_MAX;
+        sp = 0;
+        player = pov;
+        if (!enter()) sp = -1;
+    }
+    // Expands at most `budget` nodes, returns true once the search is finished.
+    bool run(long budget) {
+        player = pov;
+        for (long expanded = 0; sp >= 0 && expanded < budget;) {
+            Frame& f = frames[sp];
+            if (f.i < (int)f.board.next_valid_spots.size() && f.alpha < f.beta) {
+                int i = f.i++;
+                Point spot = f.board.next_valid_spots[i == 0 ? f.first : i <= f.first ? i - 1 : i];
+                if (sp + 1 == (int)frames.size()) frames.emplace_back();
+                Frame& parent = frames[sp];
+                Frame& child = frames[++sp];
+                child.board = parent.board;
+                child.board.put_disc(spot);
+                child.move = spot;
+                child.depth = parent.depth - 1;
+                child.alpha = parent.alpha;
+                child.beta = parent.beta;
+                node_count++;
+                expanded++;
+                if (enter()) continue;
+            } else {
+                if (tt.enabled()) {
+                    int bound = f.best.score <= f.alpha_orig ? TT_UPPER : f.best.score >= f.beta_orig ? TT_LOWER : TT_EXACT;
+                    tt.store(f.key, f.depth, bound, f.best.score, f.best.p);
+                }
+                value = f.best;
+            }
+            // frames[sp] is done with `value`, hand it to the parent.
+            Point move = frames[sp].move;
+            if (--sp >= 0) apply(frames[sp], move);
+        }
+        return sp < 0;
+    }
+    bool finished() const {
+        return sp < 0;
+    }
+    PointValue result() const {
+        return value;
+    }
+    long nodes() const {
+        return node_count;
+    }
+
+private:
+    struct Frame {
+        BasicOthelloBoard<N> board;
+        Point move;
+        int depth, alpha, beta, alpha_orig, beta_orig;
+        int first, i; // hash move index, next move to search
+        uint64_t key;
+        PointValue best;
+    };
+    std::vector<Frame> frames; // reused between searches, boards keep their allocations
+    int sp = -1;
+    int pov = 0;
+    long node_count = 0;
+    PointValue value;
+
+    // Prepares frames[sp]. False when its value is known without children (leaf or tt cutoff), it is then in `value`.
+    bool enter() {
+        Frame& f = frames[sp];
+        if (f.depth == 0 || f.board.done) {
+            value = PointValue(Point(-1, -1), heuristic(f.board));
+            return false;
+        }
+        f.alpha_orig = f.alpha;
+        f.beta_orig = f.beta;
+        f.first = f.i = 0;
+        f.key = 0;
+        if (tt.enabled()) {
+            f.key = position_key(f.board);
+            TTEntry entry;
+            if (tt.probe(f.key, entry)) {
+                if (entry.depth >= f.depth && (entry.bound == TT_EXACT
+                    || (entry.bound == TT_LOWER && entry.score >= f.beta)
+                    || (entry.bound == TT_UPPER && entry.score <= f.alpha))) {
+                    value = PointValue(entry.move, entry.score);
+                    return false;
+                }
+                for (int i = 0; i < (int)f.board.next_valid_spots.size(); i++)
+                    if (f.board.next_valid_spots[i] == entry.move) f.first = i;
+            }
+        }
+        f.best = PointValue(Point(-1, -1), f.board.cur_player == pov ? INT_MIN : INT_MAX);
+        return true;
+    }
+    void apply(Frame& f, Point move) {
+        if (f.board.cur_player == pov) {
+            if (value.score > f.best.score) f.best = PointValue(move, value.score);
+            if (f.best.score > f.alpha) f.alpha = f.best.score;
+        } else {
+            if (value.score < f.best.score) f.best = PointValue(move, value.score);
+            if (f.best.score < f.beta) f.beta = f.best.score;
+        }
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Exact endgame solver: negamax on the final disc difference, directly on bitboards.
+// Runs in parallel with Young Brothers Wait splitting: a node with enough empties searches its first
+// move alone, then pushes the other moves on its thread's deque and helps until they are done.
+// Idle threads steal from the front of other deques. When a move fails high the split point is
+// stopped and every task below it returns at its next check. Solved positions go into `tt`.
+template<int N>
+class EndgameSolver {
+    typedef Bitboards<N> BB;
+    typedef typename BB::Bits Bits;
+    static const int SPLIT_EMPTIES = 12;    // smaller subtrees are not worth a task
+    static const int TT_EMPTIES = 6;
+    static const int ORDER_EMPTIES = 8;     // fastest-first ordering above this
+    static const uint64_t SOLVED_TAG = 0x5d1f8c3e9ab04217ULL;
+    typedef std::chrono::steady_clock Clock;
+
+    struct SplitPoint {
+        Bits P, O;
+        int beta;
+        std::atomic<int> alpha;
+        std::atomic<int> pending;
+        std::atomic<bool> stop;
+        int best, best_move;
+        std::mutex lock;
+        SplitPoint* parent;
+    };
+    struct Task {
+        SplitPoint* sp;
+        int move;
+    };
+    struct Worker {
+        std::deque<Task> tasks;
+        std::mutex lock;
+    };
+
+public:
+    explicit EndgameSolver(int threads) : workers(std::max(threads, 1)) {}
+
+    // Exact final disc difference for the player to move (P); `best` gets the move that reaches it, or
+    // (-1, -1) when the search was stopped or ran past `until`. Subtrees solved before that stay in `tt`,
+    // so the next try starts from them.
+    int solve(Bits P, Bits O, Point& best, Clock::time_point until = Clock::time_point::max()) {
+        PROFILE_SCOPE("endgame_solve");
+        finished = false;
+        deadline = until;
+        std::vector<std::thread> helpers;
+        for (size_t id = 1; id < workers.size(); id++)
+            helpers.emplace_back([this, id]() { help(id); });
+        int move = -1;
+        int score = search(0, P, O, -N * N - 1, N * N + 1, false, nullptr, &move);
+        finished = true;
+        for (auto& t : helpers)
+            t.join();
+        best = move < 0 || cancelled(nullptr) ? Point(-1, -1) : Point(move / N, move % N);
+        return score;
+    }
+
+private:
+    std::vector<Worker> workers;
+    std::atomic<bool> finished;
+    Clock::time_point deadline;
+
+    static uint64_t key(Bits P, Bits O) {
+        return mix64(hash_bits(P) ^ mix64(hash_bits(O) + N) ^ SOLVED_TAG);
+    }
+    bool cancelled(const SplitPoint* sp) const {
+        if (search_stopped || (deadline != Clock::time_point::max() && Clock::now() > deadline)) return true;
+        for (; sp; sp = sp->parent)
+            if (sp->stop.load(std::memory_order_relaxed)) return true;
+        return false;
+    }
+
+    int search(int id, Bits P, Bits O, int alpha, int beta, bool passed, SplitPoint* parent, int* best_move) {
+        Bits empty = ~(P | O) & BB::full();
+        if (!empty) return BB::count(P) - BB::count(O);
+        int empties = BB::count(empty);
+        if (empties > TT_EMPTIES && cancelled(parent)) return 0;
+        Bits moves = BB::moves(P, O);
+        if (!moves) {
+            if (passed) return BB::count(P) - BB::count(O);
+            return -search(id, O, P, -beta, -alpha, true, parent, nullptr);
+        }
+
+        const int alpha_orig = alpha;
+        uint64_t k = 0;
+        int hash_move = -1;
+        if (empties > TT_EMPTIES && tt.enabled()) {
+            k = key(P, O);
+            TTEntry entry;
+            if (tt.probe(k, entry)) {
+                bool cutoff = entry.bound == TT_EXACT || (entry.bound == TT_LOWER && entry.score >= beta)
+                    || (entry.bound == TT_UPPER && entry.score <= alpha);
+                // the root also needs the move
+                if (cutoff && (!best_move || entry.move.x >= 0)) {
+                    if (best_move) *best_move = entry.move.x * N + entry.move.y;
+                    return entry.score;
+                }
+                if (entry.move.x >= 0) hash_move = entry.move.x * N + entry.move.y;
+            }
+        }
+
+        // Move order: hash move, then fewest opponent replies first.
+        int order[N * N], n = 0;
+        for (Bits m = moves; m; m &= m - 1) order[n++] = BB::lowest(m);
+        if (empties > ORDER_EMPTIES) {
+            int replies[N * N];
+            for (int i = 0; i < n; i++) {
+                Bits f = BB::flips(BB::bit(order[i]), P, O);
+                replies[order[i]] = order[i] == hash_move ? -1 : BB::count(BB::moves(O ^ f, P | f | BB::bit(order[i])));
+            }
+            std::sort(order, order + n, [&](int a, int b) { return replies[a] < replies[b]; });
+        }
+
+        int best = INT_MIN, move = order[0];
+        int i = 0;
+        // Eldest brother (and everything, near the leaves) serially.
+        for (; i < n; i++) {
+            Bits f = BB::flips(BB::bit(order[i]), P, O);
+            int v = -search(id, O ^ f, P | f | BB::bit(order[i]), -beta, -alpha, false, parent, nullptr);
+            if (v > best) best = v, move = order[i];
+            if (v > alpha) alpha = v;
+            if (alpha >= beta) break;
+            if (empties >= SPLIT_EMPTIES && workers.size() > 1) {
+                i++;
+                break;
+            }
+        }
+        if (alpha < beta && i < n) {
+            SplitPoint sp;
+            sp.P = P, sp.O = O, sp.beta = beta, sp.alpha = alpha, sp.stop = false;
+            sp.best = best, sp.best_move = move, sp.parent = parent;
+            sp.pending = n - i;
+            {
+                std::lock_guard<std::mutex> guard(workers[id].lock);
+                for (int j = n - 1; j >= i; j--)
+                    workers[id].tasks.push_back({&sp, order[j]});
+            }
+            while (sp.pending.load() > 0) {
+                Task task;
+                if (pop(id, task) || steal(id, task)) run(id, task);
+                else std::this_thread::yield();
+            }
+            best = sp.best, move = sp.best_move;
+        }
+        if (cancelled(parent)) return best;
+
+        if (k) {
+            int bound = best <= alpha_orig ? TT_UPPER : best >= beta ? TT_LOWER : TT_EXACT;
+            tt.store(k, empties, bound, best, Point(move / N, move % N));
+        }
+        if (best_move) *best_move = move;
+        return best;
+    }
+
+    void run(int id, const Task& task) {
+        SplitPoint* sp = task.sp;
+        if (!cancelled(sp)) {
+            int alpha = sp->alpha.load();
+            if (alpha < sp->beta) {
+                Bits f = BB::flips(BB::bit(task.move), sp->P, sp->O);
+                int v = -search(id, sp->O ^ f, sp->P | f | BB::bit(task.move), -sp->beta, -alpha, false, sp, nullptr);
+                if (!cancelled(sp)) {
+                    std::lock_guard<std::mutex> guard(sp->lock);
+                    if (v > sp->best) sp->best = v, sp->best_move = task.move;
+                    if (v > sp->alpha) sp->alpha = v;
+                    if (v >= sp->beta) sp->stop = true;
+                }
+            }
+        }
+        sp->pending--;
+    }
+
+    // Own deque from the back (newest, deepest work), other deques from the front.
+    bool pop(int id, Task& task) {
+        std::lock_guard<std::mutex> guard(workers[id].lock);
+        if (workers[id].tasks.empty()) return false;
+        task = workers[id].tasks.back();
+        workers[id].tasks.pop_back();
+        return true;
+    }
+    bool steal(int id, Task& task) {
+        for (size_t k = 1; k < workers.size(); k++) {
+            Worker& victim = workers[(id + k) % workers.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (victim.tasks.empty()) continue;
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+    void help(int id) {
+        while (!finished.load()) {
+            Task task;
+            if (pop(id, task) || steal(id, task)) run(id, task);
+            else std::this_thread::yield();
+        }
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Emergency move output.
+// The game manager kills us with SIGTERM when the time is up, so instead of stopping at a fixed depth
+// we keep deepening and let the signal handler write the best move of the last finished iteration.
+// The handler only uses async-signal-safe calls: write() to a descriptor opened up front, then _exit().
+volatile sig_atomic_t best_move_so_far = -1; // x * 16 + y
+int emergency_fd = -1;
+
+void set_best_move(Point p) {
+    best_move_so_far = p.x * 16 + p.y;
 }
 
+extern "C" void on_deadline(int sig) {
+#ifndef _WIN32
+    int move = best_move_so_far;
+    if (move >= 0 && emergency_fd >= 0) {
+        char buf[8];
+        int n = 0, x = move / 16, y = move % 16;
+        buf[n++] = '0' + x;
+        buf[n++] = ' ';
+        buf[n++] = '0' + y;
+        buf[n++] = '\n';
+        if (write(emergency_fd, buf, n) < 0) {}
+    }
+    trace.event(TRACE_DEADLINE, 0, move >= 0 ? Point(move / 16, move % 16) : Point(-1, -1), sig, 0);
+    if (trace.slow()) trace.dump();
+#ifdef PROFILE
+    profile_dump();
+#endif
+    _exit(0);
+#else
+    (void)sig;
+#endif
+}
+
+void install_deadline_handler(const char* action_file) {
+#ifndef _WIN32
+    // O_APPEND: the handler's line always lands after whatever the stream wrote before.
+    emergency_fd = open(action_file, O_WRONLY | O_APPEND);
+    signal(SIGTERM, on_deadline);
+    signal(SIGALRM, on_deadline);
+#else
+    (void)action_file;
+#endif
+}
 
+// Cheap static ordering, good enough to have a sensible move on file before searching.
+template<int N>
+Point static_best_move(const std::vector<Point>& spots) {
+    Point best = spots[0];
+    for (Point p : spots)
+        if (active_params->boardWeight[weight_index(N, p.x)][weight_index(N, p.y)]
+            > active_params->boardWeight[weight_index(N, best.x)][weight_index(N, best.y)])
+            best = p;
+    return best;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Pondering (ALPHAOTHELLO_PONDER=<seconds for our own move>, not on Windows).
+// We only run during our own move, so after writing it a detached child keeps searching the opponent's
+// replies into the memory-mapped cache. The next invocation stops the child and finds the results in `tt`.
+// The child holds a lock on a pidfile for its whole life: if the lock is free nobody is pondering, so a
+// stale pid is never signalled, and taking the lock after SIGTERM waits until the child has exited.
+int ponder_seconds = 0;
+std::string ponder_pidfile;
 
-void read_board(std::ifstream& fin) {
+extern "C" void on_stop_search(int) {
+    search_stopped = 1;
+}
+
+void stop_ponder(const std::string& pidfile) {
+#ifndef _WIN32
+    int fd = open(pidfile.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return;
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        // The child writes its pid right after locking, give it a moment if we got in between.
+        int pid = 0;
+        for (int tries = 0; pid <= 0 && tries < 100; tries++) {
+            char buf[16] = {};
+            if (pread(fd, buf, sizeof(buf) - 1, 0) > 0) pid = atoi(buf);
+            if (pid <= 0) usleep(1000);
+        }
+        if (pid > 0) kill(pid, SIGTERM);
+        flock(fd, LOCK_EX);
+    }
+    close(fd);
+#else
+    (void)pidfile;
+#endif
+}
+
+// Forks the ponderer for the position after our move; returns at once in the engine.
+template<int N>
+void start_ponder(const BasicOthelloBoard<N>& board, const std::string& pidfile) {
+#ifndef _WIN32
+    if (board.done || fork() != 0) return;
+    // Out of the game manager's process group, `timeout` signals the whole group.
+    setsid();
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGALRM, SIG_DFL);
+    alarm(PONDER_LIFETIME);
+    search_stopped = 0;
+    trace.on = false;
+    int fd = open(pidfile.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0 || flock(fd, LOCK_EX | LOCK_NB) != 0) _exit(0);
+    char buf[16];
+    int n = snprintf(buf, sizeof(buf), "%d\n", (int)getpid());
+    if (ftruncate(fd, 0) != 0 || pwrite(fd, buf, n, 0) != n) _exit(0);
+    // Nothing inherited stays open (state/action files, the emergency descriptor); the cache is a mapping.
+    int null = open("/dev/null", O_RDWR);
+    for (int i = 0; i < 3; i++)
+        dup2(null, i);
+    for (int i = 3; i < 256; i++)
+        if (i != fd) close(i);
+
+    // Positions where we are to move again, the opponent's most likely replies first.
+    std::vector<BasicOthelloBoard<N>> replies;
+    if (board.cur_player == player) replies.push_back(board);
+    else {
+        for (Point p : board.next_valid_spots) {
+            replies.push_back(board);
+            replies.back().put_disc(p);
+        }
+    }
+    std::vector<int> scores(replies.size());
+    std::vector<char> solved(replies.size());
+    std::vector<std::chrono::steady_clock::duration> deepened(replies.size()); // since the last solver try
+    for (int depth = 1; depth <= board.disc_count[BasicOthelloBoard<N>::EMPTY]; depth++) {
+        std::vector<int> order(replies.size());
+        for (size_t i = 0; i < order.size(); i++) order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return scores[a] < scores[b]; });
+        for (int i : order) {
+            const BasicOthelloBoard<N>& reply = replies[i];
+            if (reply.done || solved[i]) continue;
+            auto start = std::chrono::steady_clock::now();
+            scores[i] = MiniMax(reply, depth, INT_MIN, INT_MAX).score;
+            auto now = std::chrono::steady_clock::now();
+            deepened[i] += now - start;
+            // Same turns as write_valid_spot; a solved position goes into `tt`.
+            int empties = reply.disc_count[BasicOthelloBoard<N>::EMPTY];
+            if (empties <= search_params.endgame_empties && depth >= std::min(empties, search_params.depth)
+                && depth < empties && !search_stopped) {
+                EndgameSolver<N> solver(1);
+                Point best;
+                solver.solve(reply.bits[reply.cur_player], reply.bits[3 - reply.cur_player], best, now + deepened[i]);
+                deepened[i] = std::chrono::steady_clock::duration::zero();
+                solved[i] = best.x >= 0;
+            }
+        }
+    }
+    _exit(0);
+#else
+    (void)board; (void)pidfile;
+#endif
+}
+
+template<int N>
+void read_board(std::istream& fin, BasicOthelloBoard<N>& global) {
     fin >> player;
     global.cur_player = player;
-    for (int i = 0; i < SIZE; i++) {
-        for (int j = 0; j < SIZE; j++) {
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
             fin >> global.board[i][j];
         }
     }
+    global.sync();
 }
 
-void read_valid_spots(std::ifstream& fin) {
+// Clock line main.cpp writes after the valid spots: "time <own ms> <opponent ms> <increment ms> <move>"
+// with a time bank, "movetime <ms> <move>" with a fixed time per move. Older managers don't write it.
+struct GameClock {
+    bool bank = false;
+    long remaining = 0, opponent = 0, increment = 0;
+    int move = 0;
+};
+
+// Leaves the stream alone when there is no clock line (e.g. the next block of a file of states).
+bool read_clock(std::istream& fin, GameClock& clock) {
+    std::string kind;
+    fin >> std::ws;
+    if (fin.eof() || !isalpha(fin.peek()) || !(fin >> kind)) return false;
+    clock.bank = kind == "time";
+    if (clock.bank) fin >> clock.remaining >> clock.opponent >> clock.increment >> clock.move;
+    else if (kind == "movetime") fin >> clock.remaining >> clock.move;
+    else return false;
+    return (bool)fin;
+}
+
+// Share of the bank for this move: an even split over the moves we still expect to play, plus part of
+// the increment. A reserve is kept for starting up and writing the move. The shares are SearchParams.
+// `overhead` is a known cost of every move besides the search; it comes out of the bank for each move
+// still expected, plus one for a move gained when the opponent passes, before the rest is shared out.
+long move_budget_ms(const GameClock& clock, int empties, const SearchParams& params = search_params, long overhead = 0) {
+    long reserve = std::min(clock.remaining * params.time_reserve / 100, 500L);
+    long moves_left = std::max(empties * params.time_moves / 100, 1);
+    long budget = (clock.remaining - reserve - overhead * (moves_left + 1)) / moves_left + clock.increment * params.time_increment / 100;
+    return std::max(std::min(budget, clock.remaining - reserve - overhead), 1L);
+}
+
+// Soft deadline: SIGALRM stops the search, the best move of the last finished depth is written.
+void set_soft_deadline(long ms) {
+#ifndef _WIN32
+    signal(SIGALRM, on_stop_search);
+    struct itimerval timer = {{0, 0}, {ms / 1000, ms % 1000 * 1000}};
+    setitimer(ITIMER_REAL, &timer, nullptr);
+#else
+    (void)ms;
+#endif
+}
+
+void read_valid_spots(std::istream& fin, std::vector<Point>& next_valid_spots) {
     int n_valid_spots;
     fin >> n_valid_spots;
     int x, y;
@@ -542,7 +2112,8 @@ void read_valid_spots(std::ifstream& fin) {
     }
 }
 
-void write_valid_spot(std::ofstream& fout) {
+template<int N>
+void write_valid_spot(std::ofstream& fout, BasicOthelloBoard<N>& global, const std::vector<Point>& next_valid_spots) {
     int n_valid_spots = next_valid_spots.size();
     if(n_valid_spots == 0) return;
 
@@ -551,20 +2122,145 @@ void write_valid_spot(std::ofstream& fout) {
     // for(auto it:global.next_valid_spots){
     //     std::cout<<it.x<<it.y<<std::endl;
     // }
-    PointValue MaxPoint = MiniMax(global, DEPTH, INT_MIN, INT_MAX);
+    trace.begin(global);
+    trace.event(TRACE_MOVE_START, 0, Point(-1, -1), global.disc_count[BasicOthelloBoard<N>::EMPTY], n_valid_spots);
+    Point seed = static_best_move<N>(next_valid_spots);
+    set_best_move(seed);
+    fout << seed.x << " " << seed.y << std::endl;
+    if (n_valid_spots == 1) {
+        trace.event(TRACE_MOVE_END, 0, seed, 0, 0);
+        if (trace.slow()) trace.dump();
+        return;
+    }
+
+#ifdef _WIN32
+    // No SIGTERM to rely on, keep the fixed depth.
+    PointValue MaxPoint = MiniMax(global, search_params.depth, INT_MIN, INT_MAX);
+#else
+    // Deepen until the game manager stops us; past the number of empties the search is exact.
+    PointValue MaxPoint;
+    int max_depth = global.disc_count[BasicOthelloBoard<N>::EMPTY];
+    // Close to the end, once the short search has a fallback move, the solver takes turns with the
+    // deepening: each try runs as long as the deepening did since the one before, so a solve that
+    // cannot finish in time costs half of the move instead of all of it.
+    bool endgame = max_depth <= search_params.endgame_empties;
+    int short_depth = std::min(max_depth, search_params.depth);
+    EndgameSolver<N> solver(std::thread::hardware_concurrency());
+    auto deepening_since = std::chrono::steady_clock::now();
+    MaxPoint.p = seed;
+    for (int depth = 1; depth <= max_depth; depth++) {
+        trace.nodes = trace.tt_hits = trace.tt_cutoffs = 0;
+        trace.event(TRACE_ITERATION_START, depth, Point(-1, -1), 0, 0);
+        PointValue result = MiniMax(global, depth, INT_MIN, INT_MAX);
+        if (search_stopped) {
+            trace.event(TRACE_STOP, depth, Point(-1, -1), 0, 0);
+            break;
+        }
+        trace.event(TRACE_TT_STATS, depth, Point(-1, -1), trace.tt_hits, trace.tt_cutoffs);
+        trace.event(TRACE_ITERATION_END, depth, result.p, result.score, trace.nodes);
+        MaxPoint = result;
+        set_best_move(MaxPoint.p);
+        if (!endgame || depth < short_depth || depth == max_depth) continue;
+        auto now = std::chrono::steady_clock::now();
+        auto slice = now - deepening_since;
+        trace.event(TRACE_ENDGAME_START, 0, Point(-1, -1), max_depth,
+                    (int)std::chrono::duration_cast<std::chrono::milliseconds>(slice).count());
+        Point best;
+        int score = solver.solve(global.bits[global.cur_player], global.bits[3 - global.cur_player], best, now + slice);
+        deepening_since = std::chrono::steady_clock::now();
+        if (search_stopped) {
+            trace.event(TRACE_STOP, 0, Point(-1, -1), 0, 0);
+            break;
+        }
+        trace.event(TRACE_ENDGAME_END, 0, best, score, 0);
+        if (best.x >= 0) {
+            MaxPoint.p = best;
+            set_best_move(best);
+            break;
+        }
+    }
+#endif
+    trace.event(TRACE_MOVE_END, 0, MaxPoint.p, 0, 0);
     // Remember to flush the output to ensure the last action is written to file.
     fout << MaxPoint.p.x << " " << MaxPoint.p.y << std::endl;
     // std::cout<<"Best Spot: "<<maxim.p.x << " " <<maxim.p.y <<std ::endl;
     fout.flush();
+    if (trace.slow()) trace.dump();
+}
+
+template<int N>
+void play(std::istream& fin, std::ofstream& fout) {
+    BasicOthelloBoard<N> global;
+    std::vector<Point> next_valid_spots;
+    read_board(fin, global);
+    read_valid_spots(fin, next_valid_spots);
+    GameClock clock;
+    if (read_clock(fin, clock) && clock.bank)
+        set_soft_deadline(move_budget_ms(clock, global.disc_count[BasicOthelloBoard<N>::EMPTY]));
+    write_valid_spot(fout, global, next_valid_spots);
+    if (ponder_seconds > 0 && best_move_so_far >= 0) {
+        global.put_disc(Point(best_move_so_far / 16, best_move_so_far % 16));
+        start_ponder(global, ponder_pidfile);
+    }
 }
 
+// Tools (selfplay, ...) include this file for the engine and bring their own main.
+#ifndef ALPHAOTHELLO_NO_MAIN
 int main(int, char** argv) {
+    const char* nnue_file = getenv("ALPHAOTHELLO_NNUE");
+    nnue_load(nnue_file ? nnue_file : NNUE_FILE);
+    const char* weights_file = getenv("ALPHAOTHELLO_WEIGHTS");
+    load_params(weights_file ? weights_file : WEIGHTS_FILE, eval_params);
     std::ifstream fin(argv[1]);
     std::ofstream fout(argv[2]);
-    read_board(fin);
-    read_valid_spots(fin);
-    write_valid_spot(fout);
+    install_deadline_handler(argv[2]);
+    const char* trace_file = getenv("ALPHAOTHELLO_TRACE");
+    const char* trace_ms = getenv("ALPHAOTHELLO_TRACE_MS");
+    if (trace_file) trace.open(trace_file, trace_ms ? atoi(trace_ms) : 0);
+#ifdef PROFILE
+    const char* profile_file = getenv("ALPHAOTHELLO_PROFILE");
+    profile_open(profile_file ? profile_file : "profile.folded");
+#endif
+    std::stringstream state;
+    state << fin.rdbuf();
+    std::string player_line, row;
+    std::getline(state, player_line);
+
+    // Pondering needs the shared cache, by default next to the binary's working directory.
+    const char* ponder = getenv("ALPHAOTHELLO_PONDER");
+    const char* cache_file = getenv("ALPHAOTHELLO_CACHE");
+#ifndef _WIN32
+    ponder_seconds = ponder ? atoi(ponder) : 0;
+#endif
+    if (ponder_seconds > 0) {
+        if (!cache_file) cache_file = CACHE_FILE;
+        // One ponderer per colour, both engines may share the directory.
+        ponder_pidfile = std::string(cache_file) + ".ponder" + std::to_string(atoi(player_line.c_str()));
+        stop_ponder(ponder_pidfile);
+    }
+    const char* cache_mb = getenv("ALPHAOTHELLO_CACHE_MB");
+    size_t tt_mb = cache_mb ? atoi(cache_mb) : TT_MB;
+    if (!cache_file || !tt.open(cache_file, tt_mb, eval_signature()))
+        tt.allocate(tt_mb);
+    // Stop a bit early instead of being killed, so there is time left to start the ponderer.
+    // A time bank in the state replaces this with its own budget.
+    if (ponder_seconds > 0 && tt.shared()) set_soft_deadline(ponder_seconds * 1000L);
+    else ponder_seconds = 0;
+
+    // The board size is the number of values on the first board row of the state.
+    std::getline(state, row);
+    std::stringstream row_stream(row);
+    int size = 0, value;
+    while (row_stream >> value) size++;
+    state.seekg(0);
+    if (size == 6) play<6>(state, fout);
+    else if (size == 10) play<10>(state, fout);
+    else play<8>(state, fout);
     fin.close();
     fout.close();
+#ifdef PROFILE
+    profile_dump();
+#endif
     return 0;
 }
+#endif
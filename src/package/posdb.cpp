@@ -0,0 +1,156 @@
+// Position database tool (see posdb.h).
+//
+//   ./posdb <db> add <games> [-d depth]   add every position of a selfplay game record; `depth` is the
+//                                         search depth the scores came from (default 0: scores unknown)
+//   ./posdb <db> compact                  merge the journal into the sorted shards
+//   ./posdb <db> stats                    positions per number of empties
+//   ./posdb <db> lookup <states>          look up the positions of a file of `state` blocks
+//   ./posdb <db> sample [-n count] [-p] [-e min-max] [-s seed] [-o output]
+//                                         random positions, uniform or with -p uniform over the number
+//                                         of empties; printed as text, or records (with header) with -o
+
+#define ALPHAOTHELLO_NO_MAIN
+#include "player_new.cpp"
+#include "gamerecord.h"
+#include "posdb.h"
+
+#include <chrono>
+#include <cinttypes>
+#include <random>
+
+PosRecord to_record(const OthelloBoard& board) {
+    PosRecord r;
+    r.black = board.bits[OthelloBoard::BLACK];
+    r.white = board.bits[OthelloBoard::WHITE];
+    r.side = board.cur_player;
+    return r;
+}
+
+void print_record(const PosRecord& r) {
+    printf("%016" PRIx64 " %016" PRIx64 " %s empties %d games %d +%d =%d -%d win rate %.3f mean result %.2f score %d depth %d\n",
+           r.black, r.white, r.side == OthelloBoard::BLACK ? "O" : "X", r.empties(), r.count(), r.wins, r.draws,
+           r.losses, r.win_rate(), r.mean_result(), r.score, r.depth);
+}
+
+int add_games(PositionDB& db, const std::string& filename, int depth) {
+    GameReader reader;
+    if (!reader.open(filename) || reader.size != SIZE) {
+        std::cerr << "Error reading games: " << filename << "\n";
+        return 1;
+    }
+    GameRecord game;
+    long games = 0, positions = 0;
+    while (reader.next(game)) {
+        OthelloBoard board;
+        for (size_t i = 0; i < game.moves.size() && !board.done; i++) {
+            PosRecord r = to_record(board);
+            r.add_result(board.cur_player == OthelloBoard::BLACK ? game.result : -game.result);
+            if ((int)i >= game.random_plies) {
+                r.score = game.scores[i];
+                r.depth = depth;
+            }
+            db.append(r);
+            positions++;
+            board.put_disc(Point(game.moves[i] / SIZE, game.moves[i] % SIZE));
+        }
+        games++;
+    }
+    std::cout << games << " games, " << positions << " positions added, " << db.journal_size() << " in the journal\n";
+    return 0;
+}
+
+int lookup_states(const PositionDB& db, const std::string& filename) {
+    std::ifstream fin(filename);
+    if (!fin) {
+        std::cerr << "Error opening file: " << filename << "\n";
+        return 1;
+    }
+    OthelloBoard board;
+    std::vector<Point> spots;
+    for (int i = 0; fin >> std::ws, !fin.eof(); i++) {
+        spots.clear();
+        read_board(fin, board);
+        read_valid_spots(fin, spots);
+        GameClock clock;
+        read_clock(fin, clock);
+        if (!fin) break;
+        PosRecord found;
+        printf("%d ", i);
+        if (db.lookup(to_record(board), found)) print_record(found);
+        else printf("not found\n");
+    }
+    return 0;
+}
+
+int sample(const PositionDB& db, int argc, char** argv) {
+    long count = 10;
+    bool stratified = false;
+    int min_empties = 0, max_empties = POSDB_SHARDS - 1;
+    unsigned seed = std::chrono::steady_clock::now().time_since_epoch().count();
+    std::string output;
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 < argc && arg == "-n") count = atol(argv[++i]);
+        else if (arg == "-p") stratified = true;
+        else if (i + 1 < argc && arg == "-e") sscanf(argv[++i], "%d-%d", &min_empties, &max_empties);
+        else if (i + 1 < argc && arg == "-s") seed = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "-o") output = argv[++i];
+    }
+    std::mt19937_64 rng(seed);
+    std::ofstream fout;
+    if (!output.empty()) {
+        fout.open(output, std::ios::binary | std::ios::trunc);
+        fout.write(POSDB_MAGIC, sizeof(POSDB_MAGIC));
+    }
+    PosRecord r;
+    for (long i = 0; i < count; i++) {
+        bool ok = stratified ? db.sample_stratified(rng, r, min_empties, max_empties)
+                             : db.sample(rng, r, min_empties, max_empties);
+        if (!ok) {
+            std::cerr << "No positions to sample\n";
+            return 1;
+        }
+        if (fout.is_open()) fout.write((const char*)&r, sizeof(r));
+        else print_record(r);
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " <db> add <games> [-d depth] | compact | stats | lookup <states>"
+                  << " | sample [-n count] [-p] [-e min-max] [-s seed] [-o output]\n";
+        return 1;
+    }
+    PositionDB db;
+    if (!db.open(argv[1])) {
+        std::cerr << "Error opening database: " << argv[1] << "\n";
+        return 1;
+    }
+    std::string command = argv[2];
+    if (command == "add" && argc >= 4) {
+        int depth = argc >= 6 && std::string(argv[4]) == "-d" ? atoi(argv[5]) : 0;
+        return add_games(db, argv[3], depth);
+    }
+    if (command == "compact") {
+        auto start = std::chrono::steady_clock::now();
+        size_t journal = db.journal_size();
+        if (!db.compact()) {
+            std::cerr << "Compaction failed\n";
+            return 1;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << journal << " journal entries merged, " << db.size() << " unique positions (" << seconds << "s)\n";
+        return 0;
+    }
+    if (command == "stats") {
+        for (int e = 0; e < POSDB_SHARDS; e++)
+            if (db.size(e) > 0) std::cout << "empties " << e << ": " << db.size(e) << "\n";
+        std::cout << db.size() << " positions, " << db.journal_size() << " in the journal\n";
+        return 0;
+    }
+    if (command == "lookup" && argc >= 4) return lookup_states(db, argv[3]);
+    if (command == "sample") return sample(db, argc - 3, argv + 3);
+    std::cerr << "Unknown command: " << command << "\n";
+    return 1;
+}
@@ -0,0 +1,343 @@
+#ifndef POSDB_H
+#define POSDB_H
+
+// Position database: deduplicated 8x8 positions with training labels, kept in a directory.
+//
+// Record (32 bytes): uint64 black, uint64 white, int32 result_sum, uint16 wins, uint16 draws,
+//                    uint16 losses, int16 score, uint8 depth, uint8 side to move, uint16 reserved
+// Results and `score` (search score) are from the side to move's point of view; depth 0 means there
+// is no score. Every game the position was seen in adds its outcome to wins / draws / losses and its
+// final disc difference to result_sum, so labels are averages over all those games (win_rate(),
+// mean_result()). Counts of very common positions are halved together to stay within 16 bits.
+//
+// shard-EE.pos  positions with EE empty squares, sorted by (key, black, white, side), read through mmap
+// journal.pos   positions added since the last compaction, in any order and possibly repeated
+// Both start with the 8-byte magic "AOPOSDB2". compact() merges the journal into the shards; a repeated
+// position keeps the deepest score and adds up the results. Shards are rewritten to a temporary file and
+// renamed, so readers of the old shard are never disturbed.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <direct.h>
+#endif
+
+struct PosRecord {
+    uint64_t black = 0, white = 0;
+    int32_t result_sum = 0;
+    uint16_t wins = 0, draws = 0, losses = 0;
+    int16_t score = 0;
+    uint8_t depth = 0;
+    uint8_t side = 1; // 1 black, 2 white
+    uint16_t reserved = 0;
+
+    void add_result(int disc_difference) {
+        if (disc_difference > 0) wins++;
+        else if (disc_difference < 0) losses++;
+        else draws++;
+        result_sum += disc_difference;
+    }
+    int count() const {
+        return wins + draws + losses;
+    }
+    // Expected score of the side to move: 1 win, 0.5 draw, 0 loss.
+    double win_rate() const {
+        return count() ? (wins + 0.5 * draws) / count() : 0.5;
+    }
+    double mean_result() const {
+        return count() ? (double)result_sum / count() : 0;
+    }
+
+    int empties() const {
+        return 64 - __builtin_popcountll(black | white);
+    }
+    uint64_t key() const {
+        uint64_t h = black * 0x9e3779b97f4a7c15ULL ^ (white + side) * 0xc2b2ae3d27d4eb4fULL;
+        h ^= h >> 31;
+        h *= 0xbf58476d1ce4e5b9ULL;
+        return h ^ (h >> 29);
+    }
+    bool same_position(const PosRecord& other) const {
+        return black == other.black && white == other.white && side == other.side;
+    }
+};
+static_assert(sizeof(PosRecord) == 32, "PosRecord is stored as is");
+
+const char POSDB_MAGIC[8] = {'A', 'O', 'P', 'O', 'S', 'D', 'B', '2'};
+const int POSDB_SHARDS = 61; // 0..60 empties
+
+inline bool posdb_less(const PosRecord& a, const PosRecord& b) {
+    uint64_t ka = a.key(), kb = b.key();
+    if (ka != kb) return ka < kb;
+    if (a.black != b.black) return a.black < b.black;
+    if (a.white != b.white) return a.white < b.white;
+    return a.side < b.side;
+}
+
+// Read-only view of a shard: mmap where available, a plain read elsewhere.
+class PosShard {
+public:
+    ~PosShard() {
+        close();
+    }
+    bool open(const std::string& filename) {
+        close();
+#ifndef _WIN32
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(POSDB_MAGIC)) {
+            ::close(fd);
+            return false;
+        }
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return false;
+        mapping = p;
+        mapping_size = st.st_size;
+        const char* data = (const char*)p;
+#else
+        std::ifstream fin(filename, std::ios::binary);
+        if (!fin) return false;
+        std::string bytes((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+        if (bytes.size() < sizeof(POSDB_MAGIC)) return false;
+        copy.resize((bytes.size() - sizeof(POSDB_MAGIC)) / sizeof(PosRecord));
+        memcpy(copy.data(), bytes.data() + sizeof(POSDB_MAGIC), copy.size() * sizeof(PosRecord));
+        const char* data = bytes.data();
+#endif
+        if (memcmp(data, POSDB_MAGIC, sizeof(POSDB_MAGIC)) != 0) {
+            close();
+            return false;
+        }
+#ifndef _WIN32
+        records = (const PosRecord*)(data + sizeof(POSDB_MAGIC));
+        count = (mapping_size - sizeof(POSDB_MAGIC)) / sizeof(PosRecord);
+#else
+        records = copy.data();
+        count = copy.size();
+#endif
+        return true;
+    }
+    void close() {
+#ifndef _WIN32
+        if (mapping) munmap(mapping, mapping_size);
+        mapping = nullptr;
+#else
+        copy.clear();
+#endif
+        records = nullptr;
+        count = 0;
+    }
+    size_t size() const {
+        return count;
+    }
+    const PosRecord& operator[](size_t i) const {
+        return records[i];
+    }
+    const PosRecord* find(const PosRecord& position) const {
+        const PosRecord* it = std::lower_bound(records, records + count, position, posdb_less);
+        if (it != records + count && it->same_position(position)) return it;
+        return nullptr;
+    }
+
+private:
+    const PosRecord* records = nullptr;
+    size_t count = 0;
+#ifndef _WIN32
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+#else
+    std::vector<PosRecord> copy;
+#endif
+};
+
+class PositionDB {
+public:
+    // Creates the directory if needed and maps every shard; the journal is kept in memory.
+    bool open(const std::string& directory) {
+        dir = directory;
+#ifndef _WIN32
+        mkdir(dir.c_str(), 0755);
+#else
+        _mkdir(dir.c_str());
+#endif
+        for (int e = 0; e < POSDB_SHARDS; e++)
+            shards[e].open(shard_name(e));
+        pending.clear();
+        std::ifstream fin(journal_name(), std::ios::binary);
+        char magic[8];
+        bool existing = (bool)fin.read(magic, sizeof(magic));
+        if (existing) {
+            if (memcmp(magic, POSDB_MAGIC, sizeof(magic)) != 0) return false;
+            PosRecord r;
+            while (fin.read((char*)&r, sizeof(r)))
+                if (r.empties() < POSDB_SHARDS) pending.push_back(r);
+        }
+        fin.close();
+        journal.open(journal_name(), std::ios::binary | std::ios::app);
+        if (!journal) return false;
+        if (!existing) journal.write(POSDB_MAGIC, sizeof(POSDB_MAGIC));
+        return (bool)journal;
+    }
+    void close() {
+        journal.close();
+        for (auto& shard : shards)
+            shard.close();
+    }
+
+    bool append(const PosRecord& r) {
+        if (r.empties() >= POSDB_SHARDS) return false;
+        pending.push_back(r);
+        journal.write((const char*)&r, sizeof(r));
+        return (bool)journal;
+    }
+    // Shards are searched by binary search; the journal is scanned, compact it once it gets large.
+    bool lookup(const PosRecord& position, PosRecord& found) const {
+        bool hit = false;
+        int e = position.empties();
+        if (e >= POSDB_SHARDS) return false;
+        if (const PosRecord* r = shards[e].find(position)) {
+            found = *r;
+            hit = true;
+        }
+        for (const PosRecord& r : pending) {
+            if (!r.same_position(position)) continue;
+            if (hit) merge(found, r);
+            else found = r;
+            hit = true;
+        }
+        return hit;
+    }
+
+    bool compact() {
+        journal.flush();
+        std::vector<std::vector<PosRecord>> by_empties(POSDB_SHARDS);
+        for (const PosRecord& r : pending)
+            by_empties[r.empties()].push_back(r);
+        for (int e = 0; e < POSDB_SHARDS; e++) {
+            std::vector<PosRecord>& records = by_empties[e];
+            if (records.empty()) continue;
+            for (size_t i = 0; i < shards[e].size(); i++)
+                records.push_back(shards[e][i]);
+            std::sort(records.begin(), records.end(), posdb_less);
+            size_t n = 0;
+            for (size_t i = 0; i < records.size(); i++) {
+                if (n > 0 && records[n - 1].same_position(records[i])) merge(records[n - 1], records[i]);
+                else records[n++] = records[i];
+            }
+            records.resize(n);
+            std::string tmp = shard_name(e) + ".tmp";
+            std::ofstream fout(tmp, std::ios::binary | std::ios::trunc);
+            fout.write(POSDB_MAGIC, sizeof(POSDB_MAGIC));
+            fout.write((const char*)records.data(), records.size() * sizeof(PosRecord));
+            fout.close();
+            if (!fout) return false;
+            shards[e].close();
+#ifdef _WIN32
+            remove(shard_name(e).c_str());
+#endif
+            if (rename(tmp.c_str(), shard_name(e).c_str()) != 0) return false;
+            if (!shards[e].open(shard_name(e))) return false;
+        }
+        // Everything is in the shards now, start a new journal.
+        pending.clear();
+        journal.close();
+        journal.open(journal_name(), std::ios::binary | std::ios::trunc);
+        journal.write(POSDB_MAGIC, sizeof(POSDB_MAGIC));
+        return (bool)journal;
+    }
+
+    // Compacted positions only.
+    size_t size(int empties) const {
+        return shards[empties].size();
+    }
+    size_t size() const {
+        size_t n = 0;
+        for (const auto& shard : shards)
+            n += shard.size();
+        return n;
+    }
+    size_t journal_size() const {
+        return pending.size();
+    }
+
+    // Uniform over the compacted positions with min_empties..max_empties empty squares.
+    template<class Rng>
+    bool sample(Rng& rng, PosRecord& out, int min_empties = 0, int max_empties = POSDB_SHARDS - 1) const {
+        min_empties = std::max(min_empties, 0);
+        max_empties = std::min(max_empties, POSDB_SHARDS - 1);
+        size_t total = 0;
+        for (int e = min_empties; e <= max_empties; e++)
+            total += shards[e].size();
+        if (total == 0) return false;
+        size_t i = std::uniform_int_distribution<size_t>(0, total - 1)(rng);
+        for (int e = min_empties; e <= max_empties; e++) {
+            if (i < shards[e].size()) {
+                out = shards[e][i];
+                return true;
+            }
+            i -= shards[e].size();
+        }
+        return false;
+    }
+    // The number of empties is uniform over [min_empties, max_empties] (among the non-empty shards),
+    // then the position is uniform within that shard.
+    template<class Rng>
+    bool sample_stratified(Rng& rng, PosRecord& out, int min_empties = 0, int max_empties = POSDB_SHARDS - 1) const {
+        std::vector<int> phases;
+        for (int e = std::max(min_empties, 0); e <= std::min(max_empties, POSDB_SHARDS - 1); e++)
+            if (shards[e].size() > 0) phases.push_back(e);
+        if (phases.empty()) return false;
+        const PosShard& shard = shards[phases[std::uniform_int_distribution<size_t>(0, phases.size() - 1)(rng)]];
+        out = shard[std::uniform_int_distribution<size_t>(0, shard.size() - 1)(rng)];
+        return true;
+    }
+
+private:
+    std::string dir;
+    PosShard shards[POSDB_SHARDS];
+    std::vector<PosRecord> pending;
+    std::ofstream journal;
+
+    std::string shard_name(int empties) const {
+        char name[32];
+        snprintf(name, sizeof(name), "/shard-%02d.pos", empties);
+        return dir + name;
+    }
+    std::string journal_name() const {
+        return dir + "/journal.pos";
+    }
+    // Same position seen again: results add up, the deeper search score wins.
+    static void merge(PosRecord& into, const PosRecord& other) {
+        uint32_t wins = into.wins + other.wins, draws = into.draws + other.draws, losses = into.losses + other.losses;
+        int64_t sum = (int64_t)into.result_sum + other.result_sum;
+        while (std::max(wins, std::max(draws, losses)) > UINT16_MAX) {
+            wins = (wins + 1) / 2;
+            draws = (draws + 1) / 2;
+            losses = (losses + 1) / 2;
+            sum /= 2;
+        }
+        into.wins = wins;
+        into.draws = draws;
+        into.losses = losses;
+        into.result_sum = (int32_t)sum;
+        if (other.depth > into.depth) {
+            into.depth = other.depth;
+            into.score = other.score;
+        }
+    }
+};
+
+#endif
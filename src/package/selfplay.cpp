@@ -0,0 +1,108 @@
+// Self-play generator: plays player_new against itself on several threads and writes
+// the games in the binary format of gamerecord.h.
+//
+//   ./selfplay <output> [-n games] [-t threads] [-d depth] [-r random plies] [-s seed]
+
+#define ALPHAOTHELLO_NO_MAIN
+#include "player_new.cpp"
+#include "gamerecord.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+
+struct SelfPlayConfig {
+    std::string output;
+    int games = 1000;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    int depth = 4;
+    int random_plies = 8;
+    unsigned seed = 1;
+};
+
+std::atomic<int> games_started(0);
+std::atomic<long> positions_written(0);
+std::mutex writer_mutex;
+GameWriter writer;
+
+GameRecord play_game(const SelfPlayConfig& config, std::mt19937& rng) {
+    GameRecord game;
+    OthelloBoard board;
+    // Randomise the length of the random opening a bit as well, so openings don't all have the same parity.
+    int random_plies = config.random_plies - (int)(rng() % (config.random_plies / 2 + 1));
+    while (!board.done) {
+        Point move;
+        int score = 0;
+        if ((int)game.moves.size() < random_plies) {
+            move = board.next_valid_spots[rng() % board.next_valid_spots.size()];
+            game.random_plies++;
+        } else {
+            player = board.cur_player;
+            PointValue best = MiniMax(board, config.depth, INT_MIN, INT_MAX);
+            move = best.p;
+            score = std::min(std::max(best.score, -32767), 32767);
+        }
+        game.moves.push_back(move.x * SIZE + move.y);
+        game.scores.push_back(score);
+        board.put_disc(move);
+    }
+    game.result = board.disc_count[OthelloBoard::BLACK] - board.disc_count[OthelloBoard::WHITE];
+    return game;
+}
+
+void worker(const SelfPlayConfig& config, int id) {
+    std::mt19937 rng(config.seed * 7919 + id);
+    std::string buf;
+    int buffered = 0;
+    while (games_started++ < config.games) {
+        GameRecord game = play_game(config, rng);
+        GameWriter::encode(game, buf);
+        positions_written += game.moves.size();
+        if (++buffered == 16) {
+            std::lock_guard<std::mutex> lock(writer_mutex);
+            writer.write(buf);
+            buf.clear();
+            buffered = 0;
+        }
+    }
+    std::lock_guard<std::mutex> lock(writer_mutex);
+    writer.write(buf);
+}
+
+int main(int argc, char** argv) {
+    SelfPlayConfig config;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 < argc && arg == "-n") config.games = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "-t") config.threads = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "-d") config.depth = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "-r") config.random_plies = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "-s") config.seed = atoi(argv[++i]);
+        else config.output = arg;
+    }
+    if (config.output.empty() || config.threads < 1 || config.depth < 1 || config.random_plies < 0) {
+        std::cerr << "usage: " << argv[0] << " <output> [-n games] [-t threads] [-d depth] [-r random plies] [-s seed]\n";
+        return 1;
+    }
+    const char* nnue_file = getenv("ALPHAOTHELLO_NNUE");
+    nnue_load(nnue_file ? nnue_file : NNUE_FILE);
+    const char* weights_file = getenv("ALPHAOTHELLO_WEIGHTS");
+    load_params(weights_file ? weights_file : WEIGHTS_FILE, eval_params);
+    if (!writer.open(config.output)) {
+        std::cerr << "Error opening file: " << config.output << "\n";
+        return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < config.threads; i++)
+        threads.emplace_back(worker, std::cref(config), i);
+    for (auto& t : threads)
+        t.join();
+    writer.close();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << config.games << " games, " << positions_written << " positions in " << seconds << "s ("
+              << (long)(positions_written / seconds * 3600) << " positions/hour)\n";
+    return 0;
+}
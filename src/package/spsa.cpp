@@ -0,0 +1,289 @@
+// SPSA tuner for the runtime parameters (SearchParams and the corner() phase weights).
+// Every iteration perturbs all tuned parameters at once by +-c_k, plays a pair of games (same random
+// opening, colours swapped) between the + and the - engine and moves the parameters towards the
+// winner. Pairs run on all cores at once, each thread takes the next iteration with the current
+// values and applies its update when the pair is finished, so no core waits for a batch.
+//
+// Games are short and do not depend on the load: the clock is kept in milliseconds as in main.cpp,
+// but a search is charged `-k` nodes per millisecond instead of its wall time, plus `-O` ms for
+// starting the player and writing the move. As in main.cpp a side whose bank runs out loses, so
+// keeping a reserve pays off the way it does in real games. Each move is played
+// like write_valid_spot plays it (budget from move_budget_ms, iterative deepening, and in the endgame
+// exact searches taking turns with it) so the time management and endgame knobs are tuned as well.
+//
+//   ./spsa [-n iterations] [-t threads] [-T bank+inc ms] [-k nodes per ms] [-O overhead ms] [-r random plies]
+//          [-s seed] [-p name,name...] [-c c scale] [-R r_end] [-i report interval] [-o weights.txt]
+//
+// Starts from WEIGHTS_FILE (or $ALPHAOTHELLO_WEIGHTS) and writes every parameter to -o (by default
+// WEIGHTS_FILE) at every report, so an interrupted run keeps its progress and can be resumed.
+
+#define ALPHAOTHELLO_NO_MAIN
+#include "player_new.cpp"
+
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <random>
+#include <thread>
+
+struct EngineParams {
+    EvalParams eval;
+    SearchParams search;
+};
+
+// c_end is the perturbation at the last iteration, in parameter units.
+struct Tunable {
+    const char* name;
+    int* (*field)(EngineParams&);
+    double min, max, c_end;
+};
+
+const Tunable TUNABLES[] = {
+    {"depth", [](EngineParams& p) { return &p.search.depth; }, 1, 12, 1},
+    {"endgame_empties", [](EngineParams& p) { return &p.search.endgame_empties; }, 0, 24, 1.5},
+    {"time_reserve", [](EngineParams& p) { return &p.search.time_reserve; }, 0, 50, 2},
+    {"time_moves", [](EngineParams& p) { return &p.search.time_moves; }, 20, 100, 4},
+    {"time_increment", [](EngineParams& p) { return &p.search.time_increment; }, 0, 100, 8},
+    {"phase_mult0", [](EngineParams& p) { return &p.eval.phase_mult[0]; }, 0, 60, 3},
+    {"phase_mult1", [](EngineParams& p) { return &p.eval.phase_mult[1]; }, 0, 60, 3},
+    {"phase_mult2", [](EngineParams& p) { return &p.eval.phase_mult[2]; }, 0, 60, 3},
+    {"phase_mult3", [](EngineParams& p) { return &p.eval.phase_mult[3]; }, 0, 60, 3},
+    {"phase_empties0", [](EngineParams& p) { return &p.eval.phase_empties[0]; }, 30, 60, 2},
+    {"phase_empties1", [](EngineParams& p) { return &p.eval.phase_empties[1]; }, 0, 48, 2},
+};
+const int N_TUNABLES = sizeof(TUNABLES) / sizeof(TUNABLES[0]);
+const int N_SEARCH_TUNABLES = 5; // the rest only matter to corner(), not to the NNUE
+
+struct SpsaConfig {
+    int iterations = 2000;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    long bank = 2000, increment = 20; // ms
+    long nodes_per_ms = 100;
+    long overhead = 20; // ms per move
+    int random_plies = 8;
+    unsigned seed = 1;
+    std::vector<int> tuned; // indices into TUNABLES
+    double c_scale = 1;
+    double r_end = 0.002;
+    int report = 100;
+    std::string output = WEIGHTS_FILE;
+};
+
+SpsaConfig config;
+EngineParams base;          // parameters that are not tuned
+std::vector<double> theta;  // tuned values, one per config.tuned
+std::mutex theta_mutex;
+int next_iteration = 0, done_iterations = 0;
+double score_sum = 0;       // points of the + engine, for the reports
+std::atomic<int> flagged(0); // games lost on time
+
+EngineParams engine(const std::vector<double>& values) {
+    EngineParams p = base;
+    for (size_t i = 0; i < config.tuned.size(); i++) {
+        const Tunable& t = TUNABLES[config.tuned[i]];
+        *t.field(p) = (int)std::lround(std::min(std::max(values[i], t.min), t.max));
+    }
+    return p;
+}
+
+// One move as write_valid_spot plays it, `budget` in nodes.
+Point think(ResumableSearch<8>& search, const OthelloBoard& board, const SearchParams& params, long budget, long& used) {
+    int empties = board.disc_count[OthelloBoard::EMPTY];
+    bool endgame = empties <= params.endgame_empties;
+    int short_depth = std::min(empties, params.depth);
+    Point best = static_best_move<8>(board.next_valid_spots);
+    long deepened = 0; // nodes since the last try of the solver
+    for (int depth = 1; depth <= empties; depth++) {
+        search.start(board, depth, board.cur_player);
+        bool finished = search.run(depth == 1 ? LONG_MAX : budget - used);
+        used += search.nodes();
+        deepened += search.nodes();
+        if (!finished) return best;
+        best = search.result().p;
+        if (used >= budget) return best;
+        if (!endgame || depth < short_depth || depth == empties) continue;
+        // Stands in for a try of the endgame solver, as long as the deepening since the last one.
+        search.start(board, empties, board.cur_player);
+        finished = search.run(std::min(deepened, budget - used));
+        used += search.nodes();
+        deepened = 0;
+        if (finished) return search.result().p;
+        if (used >= budget) return best;
+    }
+    return best;
+}
+
+// Disc difference for black, or +-1 when a side ran out of time. engines[OthelloBoard::BLACK] plays black.
+int play_game(OthelloBoard board, const EngineParams* engines[3], ResumableSearch<8>& search) {
+    GameClock clocks[3];
+    for (GameClock& clock : clocks) {
+        clock.bank = true;
+        clock.remaining = config.bank;
+        clock.increment = config.increment;
+    }
+    while (!board.done) {
+        int side = board.cur_player;
+        const EngineParams& params = *engines[side];
+        GameClock& clock = clocks[side];
+        clock.opponent = clocks[3 - side].remaining;
+        Point move = board.next_valid_spots[0];
+        long used = 0;
+        // A single legal move is written without searching.
+        if (board.next_valid_spots.size() > 1) {
+            active_params = &params.eval;
+            long budget = move_budget_ms(clock, board.disc_count[OthelloBoard::EMPTY], params.search, config.overhead)
+                        * config.nodes_per_ms;
+            move = think(search, board, params.search, budget, used);
+        }
+        // Like the wall time main.cpp measures: the search, then starting the player and writing the move.
+        clock.remaining -= (used + config.nodes_per_ms - 1) / config.nodes_per_ms + config.overhead;
+        if (clock.remaining <= 0) {
+            flagged++;
+            active_params = &eval_params;
+            return side == OthelloBoard::BLACK ? -1 : 1;
+        }
+        clock.remaining += clock.increment;
+        clock.move++;
+        board.put_disc(move);
+    }
+    active_params = &eval_params;
+    return board.disc_count[OthelloBoard::BLACK] - board.disc_count[OthelloBoard::WHITE];
+}
+
+void write_output(const std::vector<double>& values) {
+    EngineParams p = engine(values);
+    std::ofstream fout(config.output);
+    write_params(fout, p.eval, p.search);
+}
+
+void report(int iteration, const std::vector<double>& values) {
+    printf("%6d  + engine %.1f%%, %d lost on time", iteration, 100.0 * score_sum / (2 * iteration), flagged.load());
+    for (size_t i = 0; i < config.tuned.size(); i++)
+        printf("  %s %.2f", TUNABLES[config.tuned[i]].name, values[i]);
+    printf("\n");
+    fflush(stdout);
+}
+
+// Standard gains: c_k = c / k^0.101, a_k = a / (A + k)^0.602 with A = iterations / 10, scaled so
+// the last iteration perturbs by c_end and moves by about r_end * c_end^2 per point of result.
+void worker() {
+    ResumableSearch<8> search;
+    const double A = config.iterations / 10.0;
+    while (true) {
+        std::vector<double> plus, minus, c(config.tuned.size());
+        std::vector<int> delta(config.tuned.size());
+        int k;
+        {
+            std::lock_guard<std::mutex> lock(theta_mutex);
+            if (next_iteration == config.iterations) return;
+            k = next_iteration++;
+            plus = minus = theta;
+        }
+        std::mt19937 rng(config.seed * 7919 + k);
+        for (size_t i = 0; i < config.tuned.size(); i++) {
+            const Tunable& t = TUNABLES[config.tuned[i]];
+            c[i] = config.c_scale * t.c_end * std::pow(config.iterations, 0.101) / std::pow(k + 1, 0.101);
+            delta[i] = rng() % 2 ? 1 : -1;
+            plus[i] += c[i] * delta[i];
+            minus[i] -= c[i] * delta[i];
+        }
+        EngineParams engines[2] = {engine(plus), engine(minus)};
+        OthelloBoard opening;
+        for (int i = 0; i < config.random_plies && !opening.done; i++)
+            opening.put_disc(opening.next_valid_spots[rng() % opening.next_valid_spots.size()]);
+        // + plays black, then white.
+        const EngineParams* first[3] = {nullptr, &engines[0], &engines[1]};
+        const EngineParams* second[3] = {nullptr, &engines[1], &engines[0]};
+        int a = play_game(opening, first, search), b = -play_game(opening, second, search);
+        double result = (a > 0) - (a < 0) + (b > 0) - (b < 0); // wins - losses of +
+        {
+            std::lock_guard<std::mutex> lock(theta_mutex);
+            for (size_t i = 0; i < config.tuned.size(); i++) {
+                const Tunable& t = TUNABLES[config.tuned[i]];
+                double c_end = config.c_scale * t.c_end;
+                double a_k = config.r_end * c_end * c_end * std::pow(A + config.iterations, 0.602)
+                    / std::pow(A + k + 1, 0.602);
+                theta[i] += a_k / c[i] * result * delta[i];
+                theta[i] = std::min(std::max(theta[i], t.min), t.max);
+            }
+            score_sum += 1 + result / 2;
+            done_iterations++;
+            if (done_iterations % config.report == 0 || done_iterations == config.iterations) {
+                report(done_iterations, theta);
+                write_output(theta);
+            }
+        }
+    }
+}
+
+bool parse_tuned(const std::string& names) {
+    std::stringstream ss(names);
+    std::string name;
+    while (std::getline(ss, name, ',')) {
+        int i = 0;
+        while (i < N_TUNABLES && name != TUNABLES[i].name) i++;
+        if (i == N_TUNABLES) return false;
+        config.tuned.push_back(i);
+    }
+    return !config.tuned.empty();
+}
+
+int main(int argc, char** argv) {
+    bool ok = true;
+    std::string names;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 < argc && arg == "-n") config.iterations = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "-t") config.threads = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "-T") {
+            config.increment = 0;
+            sscanf(argv[++i], "%ld+%ld", &config.bank, &config.increment);
+        } else if (i + 1 < argc && arg == "-k") config.nodes_per_ms = atol(argv[++i]);
+        else if (i + 1 < argc && arg == "-O") config.overhead = atol(argv[++i]);
+        else if (i + 1 < argc && arg == "-r") config.random_plies = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "-s") config.seed = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "-p") names = argv[++i];
+        else if (i + 1 < argc && arg == "-c") config.c_scale = atof(argv[++i]);
+        else if (i + 1 < argc && arg == "-R") config.r_end = atof(argv[++i]);
+        else if (i + 1 < argc && arg == "-i") config.report = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "-o") config.output = argv[++i];
+        else ok = false;
+    }
+    if (!names.empty() && !parse_tuned(names)) ok = false;
+    // Even moves without a search would flag: every game would be decided by the clock.
+    long moves = (60 - config.random_plies + 1) / 2;
+    if (moves > 0 && config.overhead * moves >= config.bank + config.increment * (moves - 1)) {
+        std::cerr << "-O " << config.overhead << " ms per move runs out of a " << config.bank << "+"
+                  << config.increment << " ms clock in " << moves << " moves\n";
+        return 1;
+    }
+    if (!ok || config.iterations < 1 || config.threads < 1 || config.bank < 1 || config.increment < 0
+        || config.nodes_per_ms < 1 || config.overhead < 0 || config.random_plies < 0 || config.c_scale <= 0 || config.r_end <= 0
+        || config.report < 1) {
+        std::cerr << "usage: " << argv[0] << " [-n iterations] [-t threads] [-T bank+inc ms] [-k nodes per ms]"
+                  << " [-O overhead ms] [-r random plies] [-s seed] [-p name,name...] [-c c scale] [-R r_end] [-i report interval]"
+                  << " [-o weights.txt]\nparameters:";
+        for (const Tunable& t : TUNABLES) std::cerr << " " << t.name;
+        std::cerr << "\n";
+        return 1;
+    }
+    const char* nnue_file = getenv("ALPHAOTHELLO_NNUE");
+    nnue_load(nnue_file ? nnue_file : NNUE_FILE);
+    const char* weights_file = getenv("ALPHAOTHELLO_WEIGHTS");
+    load_params(weights_file ? weights_file : WEIGHTS_FILE, eval_params);
+    // With the network the phase weights are not used on 8x8, only the search is tuned by default.
+    if (config.tuned.empty())
+        for (int i = 0; i < (nnue.loaded ? N_SEARCH_TUNABLES : N_TUNABLES); i++) config.tuned.push_back(i);
+    base.eval = eval_params;
+    base.search = search_params;
+    for (int i : config.tuned)
+        theta.push_back(*TUNABLES[i].field(base));
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < config.threads; i++)
+        threads.emplace_back(worker);
+    for (auto& t : threads)
+        t.join();
+    std::cout << "parameters written to " << config.output << "\n";
+    return 0;
+}
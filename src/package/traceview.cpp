@@ -0,0 +1,133 @@
+// Prints the search traces written by player_new with ALPHAOTHELLO_TRACE, one dump per traced move,
+// followed by a summary of every move and of the whole file.
+//
+//   ./traceview <trace> [-s]      -s: summaries only
+
+#define ALPHAOTHELLO_NO_MAIN
+#include "player_new.cpp"
+
+#include <cstdio>
+
+struct TraceDump {
+    TraceHeader header;
+    std::vector<uint8_t> cells;
+    std::vector<TraceEvent> events;
+};
+
+bool read_dump(std::ifstream& fin, TraceDump& dump) {
+    if (!fin.read((char*)&dump.header, sizeof(TraceHeader))) return false;
+    if (memcmp(dump.header.magic, "AOTRACE1", 8) != 0 || dump.header.count > TRACE_EVENTS
+        || dump.header.size > 10) return false;
+    dump.cells.resize(dump.header.size * dump.header.size);
+    dump.events.resize(dump.header.count);
+    fin.read((char*)dump.cells.data(), dump.cells.size());
+    fin.read((char*)dump.events.data(), dump.events.size() * sizeof(TraceEvent));
+    return (bool)fin;
+}
+
+std::string move_name(uint8_t move) {
+    if (move == 0xff) return "(-1,-1)";
+    return "(" + std::to_string(move / 16) + "," + std::to_string(move % 16) + ")";
+}
+
+void print_event(const TraceEvent& e) {
+    printf("%10.3fms  ", e.time_us / 1000.0);
+    switch (e.type) {
+    case TRACE_MOVE_START: printf("move start, %d empties, %d legal moves\n", e.a, e.b); break;
+    case TRACE_ITERATION_START: printf("depth %d start\n", e.depth); break;
+    case TRACE_ROOT_MOVE:
+        printf("  depth %d %s score %d%s\n", e.depth, move_name(e.move).c_str(), e.a, e.a <= e.b ? " (upper bound)" : "");
+        break;
+    case TRACE_TT_STATS: printf("depth %d tt hits %d cutoffs %d\n", e.depth, e.a, e.b); break;
+    case TRACE_ITERATION_END:
+        printf("depth %d done, best %s score %d, %d nodes\n", e.depth, move_name(e.move).c_str(), e.a, e.b);
+        break;
+    case TRACE_ENDGAME_START: printf("endgame solver start, %d empties, up to %dms\n", e.a, e.b); break;
+    case TRACE_ENDGAME_END:
+        if (e.move == 0xff) printf("endgame solver out of time, back to deepening\n");
+        else printf("endgame solved, best %s score %d\n", move_name(e.move).c_str(), e.a);
+        break;
+    case TRACE_STOP: printf("stopped during depth %d\n", e.depth); break;
+    case TRACE_MOVE_END: printf("move end, played %s\n", move_name(e.move).c_str()); break;
+    case TRACE_DEADLINE: printf("killed by signal %d, wrote %s\n", e.a, move_name(e.move).c_str()); break;
+    default: printf("unknown event %d\n", e.type); break;
+    }
+}
+
+// Deepest finished iteration, when it finished, and how often the best move changed on the way.
+void summarise(int index, const TraceDump& dump) {
+    int depth = 0, changes = 0;
+    uint8_t best = 0xff;
+    uint32_t last_done = 0;
+    long nodes = 0;
+    bool killed = false, solved = false;
+    for (const TraceEvent& e : dump.events) {
+        if (e.type == TRACE_ITERATION_END) {
+            if (best != 0xff && e.move != best) changes++;
+            best = e.move;
+            depth = e.depth;
+            last_done = e.time_us;
+            nodes += e.b;
+        } else if (e.type == TRACE_ENDGAME_END && e.move != 0xff) {
+            solved = true;
+            last_done = e.time_us;
+        } else if (e.type == TRACE_DEADLINE) killed = true;
+    }
+    const TraceHeader& h = dump.header;
+    printf("move %d: %.1fms, depth %d%s, best move changed %d times, %ld nodes", index, h.elapsed_us / 1000.0,
+           depth, solved ? " + solved" : "", changes, nodes);
+    printf(", %.1fms after the last result%s", (h.elapsed_us - last_done) / 1000.0, killed ? ", killed" : "");
+    if (h.total > h.count) printf(", %u events lost", h.total - h.count);
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    std::string input;
+    bool summary_only = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-s") summary_only = true;
+        else input = arg;
+    }
+    if (input.empty()) {
+        std::cerr << "usage: " << argv[0] << " <trace> [-s]\n";
+        return 1;
+    }
+    std::ifstream fin(input, std::ios::binary);
+    if (!fin) {
+        std::cerr << "Error opening file: " << input << "\n";
+        return 1;
+    }
+    std::vector<TraceDump> dumps;
+    TraceDump dump;
+    while (read_dump(fin, dump))
+        dumps.push_back(dump);
+
+    if (!summary_only) {
+        for (size_t i = 0; i < dumps.size(); i++) {
+            const TraceDump& d = dumps[i];
+            int size = d.header.size;
+            printf("=== move %zu, %s to move\n", i, d.header.player == 1 ? "O" : "X");
+            for (int x = 0; x < size; x++) {
+                printf("    ");
+                for (int y = 0; y < size; y++)
+                    printf("%c", d.cells[x * size + y] == 1 ? 'O' : d.cells[x * size + y] == 2 ? 'X' : '.');
+                printf("\n");
+            }
+            for (const TraceEvent& e : d.events)
+                print_event(e);
+        }
+        printf("\n");
+    }
+    uint32_t slowest = 0, total = 0;
+    size_t slowest_index = 0;
+    for (size_t i = 0; i < dumps.size(); i++) {
+        summarise(i, dumps[i]);
+        total += dumps[i].header.elapsed_us / 1000;
+        if (dumps[i].header.elapsed_us > slowest) slowest = dumps[i].header.elapsed_us, slowest_index = i;
+    }
+    if (!dumps.empty())
+        printf("%zu moves, mean %.1fms, slowest move %zu (%.1fms)\n", dumps.size(), (double)total / dumps.size(),
+               slowest_index, slowest / 1000.0);
+    return 0;
+}
@@ -0,0 +1,457 @@
+// Texel-style tuner for the corner() evaluation weights.
+// Streams positions out of selfplay game records, turns each one into a short sparse feature list
+// and fits the weights with multithreaded gradient descent on the logistic loss of the game result.
+// Positions are processed in batches of at most -b positions so the memory use stays bounded. When
+// all of them fit in -c positions, the features of the first epoch are kept and the games are not
+// replayed again. At the end the loss of corner() itself (integer rounding included) is reported for
+// the old and new weights, scored in batches with evaluate_batch().
+// -n also exports the square weights as a network for the NNUE path (see write_nnue); with -e 0 no
+// games are needed and the weights of the current weights file are exported.
+//
+//   ./tuner <games.bin>... [-o weights.txt] [-n nnue.bin] [-t threads] [-e epochs] [-b batch] [-c cache]
+//           [-i steps] [-l rate] [-k K]
+
+#define ALPHAOTHELLO_NO_MAIN
+#include "player_new.cpp"
+#include "gamerecord.h"
+
+#include <cmath>
+#include <thread>
+
+// Tuned parameters: the 10 symmetric boardWeight classes, then the corner() bonuses.
+enum {
+    P_SQUARE = 0,
+    P_CORNER = 10,
+    P_C_SQUARE,
+    P_X_SQUARE,
+    P_EDGE_RUN,
+    P_MOBILITY,
+    N_PARAMS
+};
+
+struct TunerConfig {
+    std::vector<std::string> inputs;
+    std::string output = WEIGHTS_FILE;
+    std::string network;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    int epochs = 10;
+    size_t batch = 4000000;
+    size_t cache = 16000000; // positions, about 32 bytes each
+    int steps = 20;
+    double rate = 0.1;
+    double K = 0;
+};
+
+// Positions of a batch, features stored as (param, value) pairs.
+struct Batch {
+    std::vector<uint32_t> start;
+    std::vector<uint8_t> index;
+    std::vector<int8_t> value;
+    std::vector<int16_t> base;      // disc difference, not weighted
+    std::vector<uint8_t> phase;     // which phase_mult applies
+    std::vector<uint8_t> result;    // 0 loss, 1 draw, 2 win for the side to move
+    size_t size() const { return base.size(); }
+    void clear() {
+        start.assign(1, 0);
+        index.clear(); value.clear(); base.clear(); phase.clear(); result.clear();
+    }
+};
+
+int square_class(int i, int j) {
+    int a = std::min(i, 7 - i), b = std::min(j, 7 - j);
+    if (a > b) std::swap(a, b);
+    static const int first[4] = {0, 4, 7, 9};
+    return first[a] + b - a;
+}
+
+double param_scale(int k) {
+    return k < P_CORNER ? 0.1 : 1.0; // corner() adds boardWeight * 0.1
+}
+
+struct CornerShape {
+    Point corner, c1, c2, x;
+    int row, run_start, run_step;
+};
+const CornerShape corners[4] = {
+    {Point(0, 0), Point(0, 1), Point(1, 0), Point(1, 1), 0, 1, 1},
+    {Point(0, 7), Point(1, 7), Point(0, 6), Point(1, 6), 0, 6, -1},
+    {Point(7, 0), Point(7, 1), Point(6, 0), Point(6, 1), 7, 1, 1},
+    {Point(7, 7), Point(6, 7), Point(7, 6), Point(6, 6), 7, 6, -1},
+};
+
+// Same terms as corner(), for a position evaluated by the side to move.
+void add_position(Batch& batch, const OthelloBoard& now, int result) {
+    int me = now.cur_player, op = 3 - me;
+    int feature[N_PARAMS] = {0};
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 8; j++) {
+            if (now.board[i][j] == me) feature[P_SQUARE + square_class(i, j)]++;
+            else if (now.board[i][j] == op) feature[P_SQUARE + square_class(i, j)]--;
+        }
+    }
+    int owned[3] = {0, 0, 0};
+    for (const CornerShape& c : corners) {
+        int owner = now.board[c.corner.x][c.corner.y];
+        if (owner == OthelloBoard::EMPTY) continue;
+        int sign = owner == me ? 1 : -1;
+        owned[owner]++;
+        feature[P_CORNER] += sign;
+        int run = 0;
+        for (int k = 0, y = c.run_start; k < 6 && now.board[c.row][y] == owner; k++, y += c.run_step)
+            run++;
+        feature[P_EDGE_RUN] += sign * (run == 6 ? 12 : run);
+        feature[P_C_SQUARE] += sign * ((now.board[c.c1.x][c.c1.y] == owner) + (now.board[c.c2.x][c.c2.y] == owner));
+        feature[P_X_SQUARE] += sign * (now.board[c.x.x][c.x.y] == owner);
+    }
+    feature[P_MOBILITY] = now.next_valid_spots.size();
+
+    int empties = now.disc_count[OthelloBoard::EMPTY];
+    int phase;
+    if (empties > eval_params.phase_empties[0] && owned[me] == 0) phase = 0;
+    else if (owned[op] > owned[me]) phase = 1;
+    else if (empties > eval_params.phase_empties[1]) phase = 2;
+    else phase = 3;
+
+    for (int k = 0; k < N_PARAMS; k++) {
+        if (feature[k] == 0) continue;
+        batch.index.push_back(k);
+        batch.value.push_back(feature[k]);
+    }
+    batch.start.push_back(batch.index.size());
+    batch.base.push_back(now.disc_count[me] - now.disc_count[op]);
+    batch.phase.push_back(phase);
+    batch.result.push_back(result);
+}
+
+double predict(const Batch& batch, size_t i, const double* w) {
+    double points = 0;
+    for (uint32_t f = batch.start[i]; f < batch.start[i + 1]; f++)
+        points += w[batch.index[f]] * param_scale(batch.index[f]) * batch.value[f];
+    return batch.base[i] + eval_params.phase_mult[batch.phase[i]] * points;
+}
+
+double sigmoid(double K, double s) {
+    return 1.0 / (1.0 + std::exp(-K * s));
+}
+
+// Mean squared error of the predicted win probability; adds the gradient into `grad` if given.
+double evaluate(const Batch& batch, const double* w, double K, int threads, double* grad) {
+    std::vector<double> loss(threads, 0.0);
+    std::vector<std::array<double, N_PARAMS>> partial(threads);
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; t++) {
+        pool.emplace_back([&, t]() {
+            std::array<double, N_PARAMS>& g = partial[t];
+            g.fill(0.0);
+            size_t lo = batch.size() * t / threads, hi = batch.size() * (t + 1) / threads;
+            for (size_t i = lo; i < hi; i++) {
+                double p = sigmoid(K, predict(batch, i, w));
+                double err = p - batch.result[i] * 0.5;
+                loss[t] += err * err;
+                if (!grad) continue;
+                double d = 2 * err * p * (1 - p) * K * eval_params.phase_mult[batch.phase[i]];
+                for (uint32_t f = batch.start[i]; f < batch.start[i + 1]; f++)
+                    g[batch.index[f]] += d * param_scale(batch.index[f]) * batch.value[f];
+            }
+        });
+    }
+    for (auto& t : pool)
+        t.join();
+    double total = 0;
+    for (int t = 0; t < threads; t++) {
+        total += loss[t];
+        if (grad)
+            for (int k = 0; k < N_PARAMS; k++) grad[k] += partial[t][k] / batch.size();
+    }
+    return total / batch.size();
+}
+
+// Fills `batch` with up to config.batch positions; returns false when all inputs are exhausted.
+class PositionStream {
+public:
+    PositionStream(const TunerConfig& config) : config(config) {}
+    bool fill(Batch& batch) {
+        batch.clear();
+        GameRecord game;
+        while (batch.size() < config.batch) {
+            if (!reader_open) {
+                if (file >= config.inputs.size()) break;
+                reader = GameReader();
+                if (!reader.open(config.inputs[file++]) || reader.size != SIZE) {
+                    std::cerr << "Skipping " << config.inputs[file - 1] << ": not an 8x8 game record\n";
+                    continue;
+                }
+                reader_open = true;
+            }
+            if (!reader.next(game)) {
+                reader.close();
+                reader_open = false;
+                continue;
+            }
+            OthelloBoard board;
+            for (uint8_t move : game.moves) {
+                int diff = board.cur_player == OthelloBoard::BLACK ? game.result : -game.result;
+                add_position(batch, board, diff > 0 ? 2 : diff == 0 ? 1 : 0);
+                board.put_disc(Point(move / SIZE, move % SIZE));
+            }
+        }
+        return batch.size() > 0;
+    }
+private:
+    const TunerConfig& config;
+    GameReader reader;
+    bool reader_open = false;
+    size_t file = 0;
+};
+
+// Picks the sigmoid scale that best explains the results with the current weights.
+double fit_K(const Batch& batch, const double* w, int threads) {
+    double best_K = 1e-3, best_loss = 1e9;
+    for (double e = -5; e <= -1; e += 0.05) {
+        double K = std::pow(10.0, e);
+        double loss = evaluate(batch, w, K, threads, nullptr);
+        if (loss < best_loss) best_loss = loss, best_K = K;
+    }
+    return best_K;
+}
+
+// Loss of what the engine really computes, corner() with its integer rounding, for each parameter
+// set over every position of the inputs. Positions are scored 8 at a time with evaluate_batch().
+void engine_loss(const TunerConfig& config, const EvalParams* params[2], double K, double loss[2]) {
+    const EvalParams* saved = active_params;
+    EvalBatch<8> batch(4096);
+    std::vector<int> scores(batch.capacity), results;
+    size_t positions = 0;
+    loss[0] = loss[1] = 0;
+    auto flush = [&]() {
+        for (int k = 0; k < 2; k++) {
+            active_params = params[k];
+            evaluate_batch(batch, scores.data());
+            for (int i = 0; i < batch.count; i++) {
+                double err = sigmoid(K, scores[i]) - results[i] * 0.5;
+                loss[k] += err * err;
+            }
+        }
+        positions += batch.count;
+        batch.clear();
+        results.clear();
+    };
+    for (const std::string& input : config.inputs) {
+        GameReader reader;
+        if (!reader.open(input) || reader.size != SIZE) continue;
+        GameRecord game;
+        while (reader.next(game)) {
+            OthelloBoard board;
+            for (uint8_t move : game.moves) {
+                int diff = board.cur_player == OthelloBoard::BLACK ? game.result : -game.result;
+                batch.add(board, board.cur_player);
+                results.push_back(diff > 0 ? 2 : diff == 0 ? 1 : 0);
+                if (batch.count == batch.capacity) flush();
+                board.put_disc(Point(move / SIZE, move % SIZE));
+            }
+        }
+    }
+    if (batch.count > 0) flush();
+    active_params = saved;
+    for (int k = 0; k < 2 && positions > 0; k++) loss[k] /= positions;
+}
+
+void params_to_vector(const EvalParams& params, double* w) {
+    for (int i = 0; i < 8; i++)
+        for (int j = 0; j < 8; j++)
+            w[P_SQUARE + square_class(i, j)] = params.boardWeight[i][j];
+    w[P_CORNER] = params.corner;
+    w[P_C_SQUARE] = params.c_square;
+    w[P_X_SQUARE] = params.x_square;
+    w[P_EDGE_RUN] = params.edge_run;
+    w[P_MOBILITY] = params.mobility;
+}
+
+void vector_to_params(const double* w, EvalParams& params) {
+    for (int i = 0; i < 8; i++)
+        for (int j = 0; j < 8; j++)
+            params.boardWeight[i][j] = (int)std::lround(w[P_SQUARE + square_class(i, j)]);
+    params.corner = (int)std::lround(w[P_CORNER]);
+    params.c_square = (int)std::lround(w[P_C_SQUARE]);
+    params.x_square = (int)std::lround(w[P_X_SQUARE]);
+    params.edge_run = (int)std::lround(w[P_EDGE_RUN]);
+    params.mobility = (int)std::lround(w[P_MOBILITY]);
+}
+
+// A network computing the disc difference plus the square weights of corner() at the midgame
+// multiplier: per square +-(1 + boardWeight * 0.1 * phase_mult[2]) for own / opponent discs. The
+// squares are spread over 16 groups, each group is a pair of hidden units clip(x) and clip(-x) whose
+// output weights +O and -O give O * x back exactly while |x| <= NN_CLIP. The opponent's half of the
+// output layer is zero. The corner bonuses and mobility are not representable and are left out, so
+// this is a starting point (and a known network for the kernels), not a replacement for corner().
+bool write_nnue(const std::string& filename, const EvalParams& params) {
+    const int GROUPS = NN_HIDDEN / 2, SHIFT = 6;
+    double value[64];
+    for (int sq = 0; sq < 64; sq++)
+        value[sq] = 1 + params.boardWeight[sq / 8][sq % 8] * 0.1 * params.phase_mult[2];
+    // Largest |value| first, each into the group with the smallest total so far.
+    int order[64], group[64];
+    double total[GROUPS] = {0};
+    for (int sq = 0; sq < 64; sq++) order[sq] = sq;
+    std::sort(order, order + 64, [&](int a, int b) { return std::fabs(value[a]) > std::fabs(value[b]); });
+    for (int sq : order) {
+        int g = std::min_element(total, total + GROUPS) - total;
+        group[sq] = g;
+        total[g] += std::fabs(value[sq]);
+    }
+    // Output = sum of O * x >> SHIFT, so x is the value scaled by 2^SHIFT / O. The smallest O (finest
+    // weights) whose rounded group totals stay within NN_CLIP.
+    double largest = *std::max_element(total, total + GROUPS);
+    int O = std::max(1, (int)std::ceil(largest * (1 << SHIFT) / NN_CLIP));
+    for (;; O++) {
+        if (O > 127) {
+            std::cerr << "Square weights too large for the network\n";
+            return false;
+        }
+        long rounded[GROUPS] = {0};
+        for (int sq = 0; sq < 64; sq++)
+            rounded[group[sq]] += std::labs(std::lround(value[sq] * (1 << SHIFT) / O));
+        if (*std::max_element(rounded, rounded + GROUPS) <= NN_CLIP) break;
+    }
+    double scale = (double)(1 << SHIFT) / O;
+    NNUE net;
+    std::fill(net.bias, net.bias + NN_HIDDEN, 0);
+    std::fill(&net.weight[0][0], &net.weight[0][0] + NN_INPUTS * NN_HIDDEN, 0);
+    std::fill(net.out, net.out + 2 * NN_HIDDEN, 0);
+    for (int sq = 0; sq < 64; sq++) {
+        int16_t w = (int16_t)std::lround(value[sq] * scale);
+        int g = group[sq];
+        net.weight[sq][2 * g] = w;            // own disc
+        net.weight[sq][2 * g + 1] = -w;
+        net.weight[64 + sq][2 * g] = -w;      // opponent disc
+        net.weight[64 + sq][2 * g + 1] = w;
+    }
+    for (int g = 0; g < GROUPS; g++) {
+        net.out[2 * g] = O;
+        net.out[2 * g + 1] = -O;
+    }
+    int32_t hidden = NN_HIDDEN, out_bias = 0, out_shift = SHIFT;
+    std::ofstream fout(filename, std::ios::binary);
+    fout.write("AONNUE01", 8);
+    fout.write((const char*)&hidden, sizeof(hidden));
+    fout.write((const char*)net.bias, sizeof(net.bias));
+    fout.write((const char*)net.weight, sizeof(net.weight));
+    fout.write((const char*)net.out, sizeof(net.out));
+    fout.write((const char*)&out_bias, sizeof(out_bias));
+    fout.write((const char*)&out_shift, sizeof(out_shift));
+    return (bool)fout;
+}
+
+int main(int argc, char** argv) {
+    TunerConfig config;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 < argc && arg == "-o") config.output = argv[++i];
+        else if (i + 1 < argc && arg == "-n") config.network = argv[++i];
+        else if (i + 1 < argc && arg == "-t") config.threads = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "-e") config.epochs = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "-b") config.batch = atol(argv[++i]);
+        else if (i + 1 < argc && arg == "-c") config.cache = atol(argv[++i]);
+        else if (i + 1 < argc && arg == "-i") config.steps = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "-l") config.rate = atof(argv[++i]);
+        else if (i + 1 < argc && arg == "-k") config.K = atof(argv[++i]);
+        else config.inputs.push_back(arg);
+    }
+    if ((config.inputs.empty() && config.epochs > 0) || config.threads < 1 || config.batch < 1 || config.epochs < 0) {
+        std::cerr << "usage: " << argv[0] << " <games.bin>... [-o weights.txt] [-n nnue.bin] [-t threads]"
+                     " [-e epochs] [-b batch] [-c cache] [-i steps] [-l rate] [-k K]\n";
+        return 1;
+    }
+    // Start from the weights the engine would use.
+    const char* weights_file = getenv("ALPHAOTHELLO_WEIGHTS");
+    load_params(weights_file ? weights_file : WEIGHTS_FILE, eval_params);
+
+    const EvalParams initial = eval_params;
+    double w[N_PARAMS];
+    params_to_vector(eval_params, w);
+    // Adam state
+    double m[N_PARAMS] = {0}, v[N_PARAMS] = {0};
+    long t = 0;
+
+    // The batches of the first epoch, kept while they all fit in config.cache positions.
+    std::vector<Batch> cache;
+    size_t cached_positions = 0;
+    bool cache_complete = false, cache_full = false;
+    Batch streamed;
+    for (int epoch = 0; epoch < config.epochs; epoch++) {
+        PositionStream stream(config);
+        double epoch_loss = 0;
+        size_t epoch_positions = 0;
+        for (size_t b = 0;; b++) {
+            Batch* current;
+            if (cache_complete) {
+                if (b == cache.size()) break;
+                current = &cache[b];
+            } else {
+                if (!stream.fill(streamed)) break;
+                current = &streamed;
+                if (epoch == 0 && !cache_full) {
+                    if (cached_positions + streamed.size() <= config.cache) {
+                        cached_positions += streamed.size();
+                        cache.push_back(std::move(streamed));
+                        current = &cache.back();
+                    } else {
+                        cache_full = true;
+                        std::vector<Batch>().swap(cache);
+                    }
+                }
+            }
+            Batch& batch = *current;
+            if (config.K == 0) {
+                config.K = fit_K(batch, w, config.threads);
+                std::cout << "K = " << config.K << "\n";
+            }
+            for (int step = 0; step < config.steps; step++) {
+                double grad[N_PARAMS] = {0};
+                double loss = evaluate(batch, w, config.K, config.threads, grad);
+                if (step == 0) {
+                    epoch_loss += loss * batch.size();
+                    epoch_positions += batch.size();
+                }
+                t++;
+                for (int k = 0; k < N_PARAMS; k++) {
+                    m[k] = 0.9 * m[k] + 0.1 * grad[k];
+                    v[k] = 0.999 * v[k] + 0.001 * grad[k] * grad[k];
+                    double mh = m[k] / (1 - std::pow(0.9, t)), vh = v[k] / (1 - std::pow(0.999, t));
+                    w[k] -= config.rate * mh / (std::sqrt(vh) + 1e-12);
+                }
+            }
+        }
+        if (epoch_positions == 0) {
+            std::cerr << "No positions found\n";
+            return 1;
+        }
+        if (epoch == 0 && !cache_full) cache_complete = true;
+        std::cout << "epoch " << epoch + 1 << ": " << epoch_positions << " positions, loss "
+                  << epoch_loss / epoch_positions << "\n";
+    }
+
+    vector_to_params(w, eval_params);
+    if (config.epochs > 0) {
+        const EvalParams* compared[2] = {&initial, &eval_params};
+        double loss[2];
+        engine_loss(config, compared, config.K, loss);
+        std::cout << "engine evaluation loss " << loss[0] << " -> " << loss[1] << "\n";
+    }
+    if (!config.network.empty()) {
+        if (!write_nnue(config.network, eval_params)) {
+            std::cerr << "Error writing network: " << config.network << "\n";
+            return 1;
+        }
+        std::cout << "Network written to " << config.network << "\n";
+        if (config.epochs == 0) return 0;
+    }
+    std::ofstream fout(config.output);
+    write_params(fout, eval_params);
+    if (!fout) {
+        std::cerr << "Error writing file: " << config.output << "\n";
+        return 1;
+    }
+    std::cout << "Weights written to " << config.output << "\n";
+    return 0;
+}